@@ -0,0 +1,477 @@
+#include <QtTest>
+
+#include "simulatedhardware.h"
+#include "settings.h"
+#include "watchdog.h"
+#include "watertower.h"
+#include "alarmcontroller.h"
+
+/*
+ * The rule compiler and the evaluation of the built in high water level
+ * rule of tower 0, 8 sensors 50 cm apart. Readings and times are set on
+ * the controller directly and no tower is polled; only the tick test waits
+ * for the clock. Snooze, pause, resume and acknowledge take their time from
+ * the controller's clock, their tests evaluate at times relative to it.
+ */
+class AlarmRulesTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void parseError_data();
+    void parseError();
+    void precedence_data();
+    void precedence();
+    void unknownTower_data();
+    void unknownTower();
+    void raiseAndClear();
+    void hysteresis();
+    void hold();
+    void holdInterrupted();
+    void offlineTower();
+    void rate();
+    void offline();
+    void offlineClocked();
+    void tick();
+    void snooze();
+    void pauseAndResume();
+    void acknowledgeRepeat();
+
+private:
+    double value(const QString &text);
+    void setLevel(int tower, int centimetre);
+    void evaluate(qint64 time);
+    qint64 now() const;
+
+    AlarmController *controller;
+    int index;
+};
+
+void AlarmRulesTest::initTestCase()
+{
+    /* created up front, MultiPointCom and the towers check in with it */
+    simulateHardware();
+    Watchdog::instance();
+
+    WaterTower *tower = WaterTower::instance(0);
+    tower->setLevelSensorHeight(50);
+    tower->setSensorNumber(8);
+    tower->setAlarmEnable(true);
+
+    controller = AlarmController::instance();
+    index = controller->ruleIndex.value(AlarmController::towerRule(0), -1);
+    QVERIFY(index >= 0);
+}
+
+void AlarmRulesTest::init()
+{
+    AlarmController::Rule &rule = controller->ruleList[index];
+    if (rule.active)
+        controller->clear(rule);
+    rule.hold = 0;
+    rule.repeat = 0;
+    rule.paused = false;
+    rule.since = -1;
+    rule.snoozeUntil = 0;
+    controller->clockedRules.clear();
+    controller->timer->stop();
+
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        AlarmController::Tower &state = controller->towerState[i];
+        state.known = false;
+        state.online = false;
+        state.samples.clear();
+    }
+}
+
+double AlarmRulesTest::value(const QString &text)
+{
+    AlarmController::Program program;
+    QString error;
+    if (!AlarmController::compile(text, &program, &error))
+        qWarning() << text << error;
+    return controller->run(program);
+}
+
+void AlarmRulesTest::setLevel(int tower, int centimetre)
+{
+    AlarmController::Tower &state = controller->towerState[tower];
+    state.known = true;
+    state.online = true;
+    state.level = centimetre;
+}
+
+void AlarmRulesTest::evaluate(qint64 time)
+{
+    controller->evaluate(index, time);
+}
+
+qint64 AlarmRulesTest::now() const
+{
+    return controller->clock.elapsed();
+}
+
+void AlarmRulesTest::parseError_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::newRow("empty") << "";
+    QTest::newRow("dangling operator") << "1 +";
+    QTest::newRow("unclosed parenthesis") << "(1 < 2";
+    QTest::newRow("unclosed call") << "level(0";
+    QTest::newRow("unknown function") << "depth(0) > 1";
+    QTest::newRow("no such tower") << "level(6) > 1";
+    QTest::newRow("negative tower") << "level(-1) > 1";
+    QTest::newRow("bad number") << "1.2.3 > 1";
+    QTest::newRow("trailing operand") << "1 2";
+    QTest::newRow("chained comparison") << "1 < 2 < 3";
+}
+
+void AlarmRulesTest::parseError()
+{
+    QFETCH(QString, text);
+    AlarmController::Program program;
+    QString error;
+    QVERIFY(!AlarmController::compile(text, &program, &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void AlarmRulesTest::precedence_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<double>("expected");
+    QTest::newRow("product over sum") << "1 + 2 * 3" << 7.0;
+    QTest::newRow("parentheses") << "(1 + 2) * 3" << 9.0;
+    QTest::newRow("left associative minus") << "8 - 4 - 2" << 2.0;
+    QTest::newRow("left associative divide") << "8 / 4 / 2" << 1.0;
+    QTest::newRow("negate") << "-2 * 3" << -6.0;
+    QTest::newRow("divide by zero") << "(1 / 0) == (1 / 0)" << 0.0;
+    QTest::newRow("sum over comparison") << "1 + 1 == 2" << 1.0;
+    QTest::newRow("comparison over and") << "1 < 2 and 3 > 4" << 0.0;
+    QTest::newRow("and over or") << "1 or 0 and 0" << 1.0;
+    QTest::newRow("and over or, grouped") << "(1 or 0) and 0" << 0.0;
+    QTest::newRow("not over and") << "not 0 and 0" << 0.0;
+    QTest::newRow("not over or") << "not 1 or 1" << 1.0;
+    QTest::newRow("not over comparison") << "not 1 > 2" << 1.0;
+    QTest::newRow("double not") << "not not 2" << 1.0;
+    QTest::newRow("symbols") << "!0 && (0 || 1)" << 1.0;
+    QTest::newRow("keywords ignore case") << "1 AND Not 0" << 1.0;
+    QTest::newRow("less equal") << "2 <= 2" << 1.0;
+    QTest::newRow("not equal") << "2 != 2" << 0.0;
+}
+
+void AlarmRulesTest::precedence()
+{
+    QFETCH(QString, text);
+    QFETCH(double, expected);
+    QCOMPARE(value(text), expected);
+}
+
+void AlarmRulesTest::unknownTower_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("expected");
+    QTest::newRow("greater") << "level(1) > 0" << false;
+    QTest::newRow("less equal") << "level(1) <= 0" << false;
+    QTest::newRow("equal") << "level(1) == level(1)" << false;
+    QTest::newRow("not equal") << "level(1) != 0" << false;
+    QTest::newRow("percent") << "percent(1) >= 0" << false;
+    QTest::newRow("rate") << "rate(1) > -1000" << false;
+    QTest::newRow("arithmetic") << "level(1) + 1 > 0" << false;
+    QTest::newRow("or") << "level(1) > 0 or 1" << true;
+    QTest::newRow("not") << "not (level(1) > 0)" << true;
+}
+
+/* NaN, without a reading every comparison is false */
+void AlarmRulesTest::unknownTower()
+{
+    QFETCH(QString, text);
+    QFETCH(bool, expected);
+    double result = value(text);
+    QCOMPARE(result == result && result != 0, expected);
+}
+
+void AlarmRulesTest::raiseAndClear()
+{
+    QSignalSpy raised(controller, SIGNAL(alarmRaised(QString)));
+    QSignalSpy cleared(controller, SIGNAL(alarmCleared(QString)));
+    QString name = AlarmController::towerRule(0);
+
+    setLevel(0, 350);
+    evaluate(1000);
+    QVERIFY(!controller->isActive(name));
+
+    setLevel(0, 400);
+    evaluate(2000);
+    QVERIFY(controller->isActive(name));
+    QVERIFY(WaterTower::instance(0)->isAlarmActive());
+    QCOMPARE(raised.count(), 1);
+
+    /* still full, raised once */
+    evaluate(3000);
+    QCOMPARE(raised.count(), 1);
+
+    setLevel(0, 0);
+    evaluate(4000);
+    QVERIFY(!controller->isActive(name));
+    QVERIFY(!WaterTower::instance(0)->isAlarmActive());
+    QCOMPARE(cleared.count(), 1);
+    QCOMPARE(cleared.first().first().toString(), name);
+}
+
+/* cleared only a sensor below the top, not on every wobble around it */
+void AlarmRulesTest::hysteresis()
+{
+    QSignalSpy raised(controller, SIGNAL(alarmRaised(QString)));
+    QSignalSpy cleared(controller, SIGNAL(alarmCleared(QString)));
+    QString name = AlarmController::towerRule(0);
+
+    setLevel(0, 400);
+    evaluate(1000);
+    QVERIFY(controller->isActive(name));
+
+    setLevel(0, 399);
+    evaluate(2000);
+    QVERIFY(controller->isActive(name));
+
+    setLevel(0, 350);
+    evaluate(3000);
+    QVERIFY(controller->isActive(name));
+
+    setLevel(0, 400);
+    evaluate(4000);
+    QCOMPARE(raised.count(), 1);
+    QCOMPARE(cleared.count(), 0);
+
+    setLevel(0, 349);
+    evaluate(5000);
+    QVERIFY(!controller->isActive(name));
+    QCOMPARE(cleared.count(), 1);
+}
+
+void AlarmRulesTest::hold()
+{
+    QString name = AlarmController::towerRule(0);
+    controller->ruleList[index].hold = 30000;
+
+    setLevel(0, 400);
+    evaluate(1000);
+    QVERIFY(!controller->isActive(name));
+    QVERIFY(controller->clockedRules.contains(index));
+
+    evaluate(30999);
+    QVERIFY(!controller->isActive(name));
+
+    evaluate(31000);
+    QVERIFY(controller->isActive(name));
+    QVERIFY(!controller->clockedRules.contains(index));
+}
+
+/* the hold time starts over once the condition was false */
+void AlarmRulesTest::holdInterrupted()
+{
+    QString name = AlarmController::towerRule(0);
+    controller->ruleList[index].hold = 30000;
+
+    setLevel(0, 400);
+    evaluate(1000);
+    setLevel(0, 300);
+    evaluate(20000);
+    QVERIFY(!controller->clockedRules.contains(index));
+
+    setLevel(0, 400);
+    evaluate(25000);
+    evaluate(31000);
+    QVERIFY(!controller->isActive(name));
+
+    evaluate(55000);
+    QVERIFY(controller->isActive(name));
+}
+
+/* the built in rule only raises for a tower that answers */
+void AlarmRulesTest::offlineTower()
+{
+    QString name = AlarmController::towerRule(0);
+
+    setLevel(0, 400);
+    controller->towerState[0].online = false;
+    evaluate(1000);
+    QVERIFY(!controller->isActive(name));
+
+    controller->towerState[0].online = true;
+    evaluate(2000);
+    QVERIFY(controller->isActive(name));
+}
+
+/* centimetres per minute between the oldest and newest sample kept */
+void AlarmRulesTest::rate()
+{
+    AlarmController::Tower &state = controller->towerState[0];
+    state.known = true;
+    state.level = 110;
+    state.samples.append(qMakePair(qint64(0), 100));
+    QVERIFY(value("rate(0)") != value("rate(0)"));
+
+    state.samples.append(qMakePair(qint64(15000), 104));
+    state.samples.append(qMakePair(qint64(30000), 110));
+    QCOMPARE(value("rate(0)"), 20.0);
+    QCOMPARE(value("rate(0) > 10 and level(0) > 100"), 1.0);
+
+    state.samples.append(qMakePair(qint64(60000), 95));
+    QCOMPARE(value("rate(0)"), -5.0);
+}
+
+void AlarmRulesTest::offline()
+{
+    AlarmController::Tower &state = controller->towerState[1];
+    state.online = true;
+    QCOMPARE(value("offline(1)"), 0.0);
+    QCOMPARE(value("online(1)"), 1.0);
+
+    state.online = false;
+    state.offlineSince = now() - 5000;
+    QCOMPARE(value("offline(1) >= 5 and offline(1) < 60"), 1.0);
+    QCOMPARE(value("online(1)"), 0.0);
+}
+
+/* a rule over offline() changes with time alone, the tick runs it while the tower is away */
+void AlarmRulesTest::offlineClocked()
+{
+    static const QString name = "test-offline";
+    if (!controller->contains(name)) {
+        AlarmController::Rule rule;
+        rule.name = name;
+        rule.tower = -1;
+        rule.priority = NotifyPanel::Low;
+        rule.hold = 0;
+        rule.repeat = 0;
+        rule.paused = false;
+        /* never true within the test, nothing is raised on the panel */
+        controller->addRule(rule, "offline(1) > 100000", "");
+    }
+    int offlineIndex = controller->ruleIndex.value(name, -1);
+    QVERIFY(offlineIndex >= 0);
+    QVERIFY(controller->ruleList.at(offlineIndex).clocked);
+
+    controller->towerState[1].online = false;
+    controller->towerState[1].offlineSince = now();
+    controller->evaluate(offlineIndex, now());
+    QVERIFY(controller->clockedRules.contains(offlineIndex));
+
+    controller->towerState[1].online = true;
+    controller->evaluate(offlineIndex, now());
+    QVERIFY(!controller->clockedRules.contains(offlineIndex));
+    QVERIFY(!controller->isActive(name));
+}
+
+/* a held rule is raised by the one second tick alone, which stops afterwards */
+void AlarmRulesTest::tick()
+{
+    QString name = AlarmController::towerRule(0);
+    controller->ruleList[index].hold = 1000;
+
+    setLevel(0, 400);
+    evaluate(now());
+    QVERIFY(!controller->isActive(name));
+    QVERIFY(controller->timer->isActive());
+
+    QTRY_VERIFY_WITH_TIMEOUT(controller->isActive(name), 5000);
+    QVERIFY(!controller->clockedRules.contains(index));
+    QVERIFY(!controller->timer->isActive());
+}
+
+/* cleared meanwhile, raised again once the snooze is over and still full */
+void AlarmRulesTest::snooze()
+{
+    QSignalSpy raised(controller, SIGNAL(alarmRaised(QString)));
+    QSignalSpy cleared(controller, SIGNAL(alarmCleared(QString)));
+    QString name = AlarmController::towerRule(0);
+
+    setLevel(0, 400);
+    evaluate(now());
+    QVERIFY(controller->isActive(name));
+
+    controller->snooze(name, 60);
+    QVERIFY(!controller->isActive(name));
+    QCOMPARE(cleared.count(), 1);
+    QVERIFY(controller->snoozeRemaining(name) > 0);
+    QVERIFY(controller->clockedRules.contains(index));
+
+    qint64 until = controller->ruleList.at(index).snoozeUntil;
+    evaluate(until - 1);
+    QVERIFY(!controller->isActive(name));
+    QCOMPARE(raised.count(), 1);
+
+    evaluate(until);
+    QVERIFY(controller->isActive(name));
+    QCOMPARE(raised.count(), 2);
+    QVERIFY(!controller->clockedRules.contains(index));
+}
+
+/* paused for good, also in the settings, until resumed */
+void AlarmRulesTest::pauseAndResume()
+{
+    QSignalSpy raised(controller, SIGNAL(alarmRaised(QString)));
+    QSignalSpy paused(controller, SIGNAL(pausedChanged(QString,bool)));
+    QString name = AlarmController::towerRule(0);
+    QString key = "AlarmRule-" + name + "/paused";
+
+    setLevel(0, 400);
+    evaluate(now());
+    QVERIFY(controller->isActive(name));
+
+    controller->pause(name);
+    QVERIFY(!controller->isActive(name));
+    QVERIFY(controller->isPaused(name));
+    QVERIFY(Settings::instance()->value(key).toBool());
+    QVERIFY(controller->pausedRules(0).contains(name));
+    QCOMPARE(paused.count(), 1);
+    QCOMPARE(paused.first().at(1).toBool(), true);
+
+    evaluate(now() + 3600 * 1000);
+    QVERIFY(!controller->isActive(name));
+    QVERIFY(!controller->clockedRules.contains(index));
+    QCOMPARE(raised.count(), 1);
+
+    /* still full, raised again right away */
+    controller->resume(name);
+    QVERIFY(!controller->isPaused(name));
+    QVERIFY(!Settings::instance()->value(key).toBool());
+    QVERIFY(controller->pausedRules(0).isEmpty());
+    QCOMPARE(paused.count(), 2);
+    QCOMPARE(paused.last().at(1).toBool(), false);
+    QVERIFY(controller->isActive(name));
+    QCOMPARE(raised.count(), 2);
+}
+
+/* reminders until acknowledged, the alarm itself stays until it clears */
+void AlarmRulesTest::acknowledgeRepeat()
+{
+    QSignalSpy reminders(WaterTower::instance(0), SIGNAL(highWaterLevelAlarm()));
+    QString name = AlarmController::towerRule(0);
+    controller->ruleList[index].repeat = 60000;
+
+    qint64 start = now();
+    setLevel(0, 400);
+    evaluate(start);
+    QCOMPARE(reminders.count(), 1);
+    QVERIFY(controller->clockedRules.contains(index));
+
+    evaluate(start + 59999);
+    QCOMPARE(reminders.count(), 1);
+    evaluate(start + 60000);
+    QCOMPARE(reminders.count(), 2);
+
+    controller->acknowledge(name);
+    QVERIFY(controller->isAcknowledged(name));
+    QVERIFY(!controller->clockedRules.contains(index));
+
+    evaluate(start + 600000);
+    QCOMPARE(reminders.count(), 2);
+    QVERIFY(controller->isActive(name));
+}
+
+QTEST_MAIN(AlarmRulesTest)
+
+#include "tst_alarmrules.moc"
@@ -0,0 +1,7 @@
+# The server without main() and what every suite shares
+
+include(../server/server.pri)
+
+INCLUDEPATH += $$PWD
+
+HEADERS += $$PWD/simulatedhardware.h
@@ -0,0 +1,14 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    watertower \
+    widgets \
+    multipointcom \
+    alarmrules \
+    jitterbuffer \
+    hal \
+    notifyqueue
+
+OTHER_FILES += \
+    benchmarks.pri \
+    run.sh
@@ -0,0 +1,9 @@
+QT       += testlib
+
+TARGET = tst_hal
+CONFIG += testcase
+TEMPLATE = app
+
+include(../benchmarks.pri)
+
+SOURCES += tst_hal.cpp
@@ -0,0 +1,161 @@
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "settings.h"
+#include "watchdog.h"
+#include "hal.h"
+
+/*
+ * Hal and Watchdog against a simulated tree in a temporary directory, laid
+ * out as server/tools/mkhwsim.sh does without --leds: the leds are driven
+ * through the gpio lines, yellow and blue sharing one.
+ */
+class HalTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void setOutput();
+    void sharedLine();
+    void brightness();
+    void blinkFallsBack();
+    void watchdogKeepAlive();
+
+private:
+    void create(const QString &path, const QByteArray &value);
+    QByteArray read(const QString &path) const;
+    QStringList writes() const;
+
+    QTemporaryDir root;
+};
+
+static const char *redLine = "/sys/class/gpio/gpio295/value";
+static const char *sharedGpio = "/sys/class/gpio/gpio296/value";
+static const char *backlight = "/sys/class/backlight/pwm-backlight.0/brightness";
+
+void HalTest::initTestCase()
+{
+    QVERIFY(root.isValid());
+    create("/dev/watchdog", "");
+    create(redLine, "0\n");
+    create(sharedGpio, "0\n");
+    create("/sys/class/backlight/pwm-backlight.0/max_brightness", "7\n");
+    create(backlight, "7\n");
+    create("/writes.log", "");
+
+    /* the brightness is kept in the settings, written below the root as well */
+    Settings::setDataDirectory(root.path());
+    Hal::setHardwareRoot(root.path());
+    QVERIFY(Hal::isSimulated());
+    Hal::instance();
+}
+
+void HalTest::create(const QString &path, const QByteArray &value)
+{
+    QFileInfo info(root.path() + path);
+    QDir().mkpath(info.path());
+    QFile file(info.filePath());
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(value);
+}
+
+QByteArray HalTest::read(const QString &path) const
+{
+    QFile file(root.path() + path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll().trimmed();
+}
+
+/* "<path> <value>" of every write so far, without the timestamps */
+QStringList HalTest::writes() const
+{
+    QStringList lines;
+    foreach (const QByteArray &line, read("/writes.log").split('\n')) {
+        if (!line.isEmpty())
+            lines << QString::fromLatin1(line).section(' ', 1);
+    }
+    return lines;
+}
+
+void HalTest::setOutput()
+{
+    int before = writes().count();
+
+    Hal::instance()->setRedLed(1);
+    QCOMPARE(read(redLine), QByteArray("1"));
+    QCOMPARE(writes().mid(before), QStringList() << QString("%1 1").arg(redLine));
+
+    /* unchanged, not written again */
+    Hal::instance()->setRedLed(1);
+    QCOMPARE(writes().count(), before + 1);
+
+    Hal::instance()->setRedLed(0);
+    QCOMPARE(read(redLine), QByteArray("0"));
+    QCOMPARE(writes().count(), before + 2);
+}
+
+/* leds on one line are merged, lit if any of them is */
+void HalTest::sharedLine()
+{
+    int before = writes().count();
+
+    QMap<Hal::Output, int> leds;
+    leds[Hal::YellowLed] = 1;
+    leds[Hal::BlueLed] = 0;
+    Hal::instance()->setOutputs(leds);
+    QCOMPARE(read(sharedGpio), QByteArray("1"));
+    QCOMPARE(writes().mid(before), QStringList() << QString("%1 1").arg(sharedGpio));
+
+    leds[Hal::YellowLed] = 0;
+    leds[Hal::RedLed] = 1;
+    Hal::instance()->setOutputs(leds);
+    QCOMPARE(read(sharedGpio), QByteArray("0"));
+    QCOMPARE(read(redLine), QByteArray("1"));
+    QCOMPARE(writes().count(), before + 3);
+
+    leds[Hal::RedLed] = 0;
+    Hal::instance()->setOutputs(leds);
+    QCOMPARE(read(redLine), QByteArray("0"));
+}
+
+void HalTest::brightness()
+{
+    QCOMPARE(Hal::instance()->getMaxBrightness(), 7);
+
+    Hal::instance()->setBrightness(3);
+    QCOMPARE(Hal::instance()->getBrightness(), 3);
+    QCOMPARE(read(backlight), QByteArray("3"));
+    QCOMPARE(writes().last(), QString("%1 3").arg(backlight));
+
+    Hal::instance()->setOutput(Hal::Backlight, 5);
+    QCOMPARE(read(backlight), QByteArray("5"));
+}
+
+/* no led class devices in this tree, the caller blinks the gpio itself */
+void HalTest::blinkFallsBack()
+{
+    int before = writes().count();
+    QVERIFY(!Hal::instance()->blinkLed(Hal::RedLed, 500, 500));
+    QCOMPARE(writes().count(), before);
+}
+
+void HalTest::watchdogKeepAlive()
+{
+    Watchdog::instance()->keepAlive();
+    QCOMPARE(read("/dev/watchdog"), QByteArray("keepalive"));
+    QVERIFY(writes().contains("/dev/watchdog keepalive"));
+
+    /* withheld while a subsystem is overdue, also by its own timer */
+    Watchdog::instance()->checkIn("test", -1);
+    QTest::qWait(10);
+    create("/dev/watchdog", "");
+    Watchdog::instance()->keepAlive();
+    QCOMPARE(read("/dev/watchdog"), QByteArray());
+    Watchdog::instance()->release("test");
+}
+
+QTEST_MAIN(HalTest)
+
+#include "tst_hal.moc"
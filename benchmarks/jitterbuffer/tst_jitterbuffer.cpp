@@ -0,0 +1,163 @@
+#include <QtTest>
+#include <QtEndian>
+
+#include "jitterbuffer.h"
+
+/*
+ * Every frame carries its sequence number plus one in all of its samples,
+ * silence reads as 0. Frames arrive on time unless a test says otherwise,
+ * which keeps the jitter at 0 and the target at MinDepth.
+ */
+class JitterBufferTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void reorder();
+    void loss();
+    void underrun();
+    void lateAfterUnderrun();
+    void duplicate();
+    void shrink();
+
+private:
+    static void push(JitterBuffer &buffer, int sequence, qint64 arrival = -1);
+    static int pull(JitterBuffer &buffer);
+    static QByteArray frame(int sequence);
+};
+
+void JitterBufferTest::push(JitterBuffer &buffer, int sequence, qint64 arrival)
+{
+    if (arrival < 0)
+        arrival = qint64(sequence) * JitterBuffer::FrameDuration;
+    buffer.push(quint16(sequence), quint32(sequence) * JitterBuffer::FrameSamples,
+                frame(sequence).constData(), arrival);
+}
+
+/* the first sample of the frame played */
+int JitterBufferTest::pull(JitterBuffer &buffer)
+{
+    QByteArray data(JitterBuffer::FrameBytes, 0);
+    buffer.pull(data.data());
+    return qFromLittleEndian<qint16>(reinterpret_cast<const uchar *>(data.constData()));
+}
+
+QByteArray JitterBufferTest::frame(int sequence)
+{
+    QByteArray data(JitterBuffer::FrameBytes, 0);
+    for (int i = 0; i < JitterBuffer::FrameSamples; i++)
+        qToLittleEndian<qint16>(sequence + 1, reinterpret_cast<uchar *>(data.data()) + 2 * i);
+    return data;
+}
+
+void JitterBufferTest::reorder()
+{
+    JitterBuffer buffer;
+    push(buffer, 1);
+    push(buffer, 0, JitterBuffer::FrameDuration);
+    push(buffer, 3);
+    push(buffer, 2, 3 * JitterBuffer::FrameDuration);
+
+    for (int i = 0; i < 4; i++)
+        QCOMPARE(pull(buffer), i + 1);
+    QCOMPARE(buffer.statistics().late.load(), 0);
+    QCOMPARE(buffer.statistics().lost.load(), 0);
+}
+
+/* a hole is concealed with the last frame, faded, and playout goes on */
+void JitterBufferTest::loss()
+{
+    JitterBuffer buffer;
+    push(buffer, 0);
+    push(buffer, 1);
+    push(buffer, 3);
+    push(buffer, 4);
+
+    QCOMPARE(pull(buffer), 1);
+    QCOMPARE(pull(buffer), 2);
+    QCOMPARE(pull(buffer), 2);
+    QCOMPARE(pull(buffer), 4);
+    QCOMPARE(pull(buffer), 5);
+    QCOMPARE(buffer.statistics().lost.load(), 1);
+    QCOMPARE(buffer.statistics().concealed.load(), 1);
+}
+
+/* once dry, playout waits for the target again */
+void JitterBufferTest::underrun()
+{
+    JitterBuffer buffer;
+    push(buffer, 0);
+    push(buffer, 1);
+    QCOMPARE(pull(buffer), 1);
+    QCOMPARE(pull(buffer), 2);
+
+    pull(buffer);
+    QCOMPARE(buffer.statistics().underruns.load(), 1);
+    QVERIFY(!buffer.isPlaying());
+
+    push(buffer, 2);
+    pull(buffer);
+    QVERIFY(!buffer.isPlaying());
+    push(buffer, 3);
+    QCOMPARE(pull(buffer), 3);
+    QVERIFY(buffer.isPlaying());
+    QCOMPARE(pull(buffer), 4);
+}
+
+/* a frame already played is late, also while refilling after an underrun */
+void JitterBufferTest::lateAfterUnderrun()
+{
+    JitterBuffer buffer;
+    push(buffer, 0);
+    push(buffer, 1);
+    pull(buffer);
+    pull(buffer);
+    pull(buffer);
+    QVERIFY(!buffer.isPlaying());
+
+    push(buffer, 0);
+    QCOMPARE(buffer.statistics().late.load(), 1);
+
+    push(buffer, 2);
+    push(buffer, 3);
+    QCOMPARE(pull(buffer), 3);
+    QCOMPARE(pull(buffer), 4);
+}
+
+void JitterBufferTest::duplicate()
+{
+    JitterBuffer buffer;
+    push(buffer, 0);
+    push(buffer, 1);
+    push(buffer, 1);
+    QCOMPARE(buffer.statistics().duplicates.load(), 1);
+    QCOMPARE(pull(buffer), 1);
+    QCOMPARE(pull(buffer), 2);
+}
+
+/* a backlog well above the target is played down, dropping the oldest frames */
+void JitterBufferTest::shrink()
+{
+    JitterBuffer buffer;
+    int sequence = 0;
+    for (; sequence < 10; sequence++)
+        push(buffer, sequence);
+
+    int previous = 0;
+    for (int i = 0; i < 400; i++, sequence++) {
+        push(buffer, sequence);
+        int played = pull(buffer);
+        QVERIFY(played > previous);
+        previous = played;
+    }
+
+    const JitterBuffer::Statistics &stats = buffer.statistics();
+    QVERIFY(stats.discarded.load() > 0);
+    QVERIFY(stats.depth.load() <= stats.target.load() + 2);
+    QCOMPARE(stats.lost.load(), 0);
+    QCOMPARE(stats.underruns.load(), 0);
+}
+
+QTEST_MAIN(JitterBufferTest)
+
+#include "tst_jitterbuffer.moc"
@@ -0,0 +1,9 @@
+QT       += testlib
+
+TARGET = tst_multipointcom
+CONFIG += testcase
+TEMPLATE = app
+
+include(../benchmarks.pri)
+
+SOURCES += tst_multipointcom.cpp
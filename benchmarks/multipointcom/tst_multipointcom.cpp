@@ -0,0 +1,84 @@
+#include <QtTest>
+#include <QThread>
+#include <QUdpSocket>
+
+#include "simulatedhardware.h"
+#include "watchdog.h"
+#include "multipointcom.h"
+
+/* answers like a node at half level, on the port MultiPointCom talks to off target */
+class Node : public QThread
+{
+    Q_OBJECT
+
+protected:
+    virtual void run()
+    {
+        QUdpSocket udp;
+        if (!udp.bind(QHostAddress::LocalHost, 19999))
+            return;
+
+        while (!isInterruptionRequested()) {
+            if (!udp.waitForReadyRead(100))
+                continue;
+            while (udp.hasPendingDatagrams()) {
+                QByteArray data(udp.pendingDatagramSize(), 0);
+                QHostAddress sender;
+                quint16 port;
+                udp.readDatagram(data.data(), data.size(), &sender, &port);
+                QByteArray reply;
+                reply.append(data.at(0));
+                reply.append('\0');
+                reply.append(QByteArray::fromHex("a8610000"));  /*  25000 us, little endian  */
+                udp.writeDatagram(reply, sender, port);
+            }
+        }
+    }
+};
+
+class MultiPointComBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void roundTrip();
+
+private:
+    Node node;
+};
+
+void MultiPointComBenchmark::initTestCase()
+{
+    simulateHardware();
+    Watchdog::instance();
+    node.start();
+    QTest::qWait(100);
+    QVERIFY(node.isRunning());
+}
+
+void MultiPointComBenchmark::cleanupTestCase()
+{
+    node.requestInterruption();
+    node.wait();
+}
+
+/* request, reply and the queued responseReceived back on this thread */
+void MultiPointComBenchmark::roundTrip()
+{
+    MultiPointCom com;
+    com.setAddress(0x10);
+    QSignalSpy spy(&com, SIGNAL(responseReceived(char,QByteArray)));
+
+    QBENCHMARK {
+        QVERIFY(com.sendRequest(0, QByteArray(1, 10)));
+        /* queued, it can only arrive once wait() spins the event loop */
+        QVERIFY(spy.wait(1000));
+        com.wait();
+    }
+}
+
+QTEST_MAIN(MultiPointComBenchmark)
+
+#include "tst_multipointcom.moc"
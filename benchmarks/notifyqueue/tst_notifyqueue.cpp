@@ -0,0 +1,97 @@
+#include <QtTest>
+
+#include "notifyqueue.h"
+
+/*
+ * Ordering and eviction of the notification queue. Priorities are those of
+ * NotifyPanel, 0 low to 2 high.
+ */
+class NotifyQueueTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void order();
+    void update();
+    void evictLowest();
+    void turnAwayLower();
+    void evictSamePriority();
+};
+
+void NotifyQueueTest::order()
+{
+    NotifyQueue queue;
+    queue.push("a", 0, "a", "");
+    queue.push("b", 2, "b", "");
+    queue.push("c", 1, "c", "");
+    queue.push("d", 2, "d", "");
+
+    QCOMPARE(queue.takeFirst().uuid, QString("b"));
+    QCOMPARE(queue.takeFirst().uuid, QString("d"));
+    QCOMPARE(queue.takeFirst().uuid, QString("c"));
+    QCOMPARE(queue.takeFirst().uuid, QString("a"));
+    QVERIFY(queue.isEmpty());
+}
+
+/* same source, one entry, moved to its new priority */
+void NotifyQueueTest::update()
+{
+    NotifyQueue queue;
+    QVERIFY(queue.push("a", 0, "first", ""));
+    QVERIFY(queue.push("b", 1, "b", ""));
+    QVERIFY(!queue.push("a", 2, "second", ""));
+
+    QCOMPARE(queue.count(), 2);
+    NotifyQueue::Entry entry = queue.takeFirst();
+    QCOMPARE(entry.uuid, QString("a"));
+    QCOMPARE(entry.text, QString("second"));
+}
+
+void NotifyQueueTest::evictLowest()
+{
+    NotifyQueue queue(2);
+    QString evicted;
+    queue.push("low", 0, "", "");
+    queue.push("high", 2, "", "");
+
+    QVERIFY(queue.push("middle", 1, "", "", &evicted));
+    QCOMPARE(evicted, QString("low"));
+    QVERIFY(queue.contains("middle"));
+    QVERIFY(!queue.contains("low"));
+    QCOMPARE(queue.overflowCount(), quint64(1));
+}
+
+/* a full queue of high alarms keeps them all and turns a low one away */
+void NotifyQueueTest::turnAwayLower()
+{
+    NotifyQueue queue(2);
+    QString evicted;
+    queue.push("a", 2, "", "");
+    queue.push("b", 2, "", "");
+
+    QVERIFY(queue.push("low", 0, "", "", &evicted));
+    QCOMPARE(evicted, QString("low"));
+    QVERIFY(!queue.contains("low"));
+    QVERIFY(queue.contains("a"));
+    QVERIFY(queue.contains("b"));
+    QCOMPARE(queue.count(), 2);
+    QCOMPARE(queue.overflowCount(), quint64(1));
+}
+
+/* among equals the newest is kept */
+void NotifyQueueTest::evictSamePriority()
+{
+    NotifyQueue queue(2);
+    QString evicted;
+    queue.push("a", 1, "", "");
+    queue.push("b", 1, "", "");
+
+    QVERIFY(queue.push("c", 1, "", "", &evicted));
+    QCOMPARE(evicted, QString("a"));
+    QCOMPARE(queue.takeFirst().uuid, QString("b"));
+    QCOMPARE(queue.takeFirst().uuid, QString("c"));
+}
+
+QTEST_MAIN(NotifyQueueTest)
+
+#include "tst_notifyqueue.moc"
@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# Run the benchmark suites and the tests next to them from the build
+# directory of benchmarks.pro and keep their results machine readable, one
+# QtTest xml and csv file each:
+#
+#   ./run.sh [output directory]
+#
+# Extra QtTest options can be passed in BENCHMARK_ARGS, e.g.
+# BENCHMARK_ARGS="-callgrind" or BENCHMARK_ARGS="-minimumvalue 100".
+#
+# The suites drive an empty simulated hardware tree, or the one built by
+# server/tools/mkhwsim.sh in SKYNET_HARDWARE_ROOT, never the board itself.
+
+out=${1:-results}
+mkdir -p "$out"
+status=0
+
+for suite in watertower widgets multipointcom alarmrules jitterbuffer hal notifyqueue; do
+    binary=$suite/tst_$suite
+    [ -x "$binary" ] || { echo "$binary not built" >&2; status=1; continue; }
+    "$binary" $BENCHMARK_ARGS \
+        -o "$out/$suite.xml,xml" \
+        -o "$out/$suite.csv,csv" \
+        -o -,txt || status=1
+done
+
+exit $status
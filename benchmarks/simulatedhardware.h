@@ -0,0 +1,30 @@
+#ifndef SIMULATEDHARDWARE_H
+#define SIMULATEDHARDWARE_H
+
+#include <QTemporaryDir>
+
+#include "hal.h"
+#include "settings.h"
+
+/*
+ * Keeps the suites off /dev/watchdog, the leds and the backlight of the
+ * board they run on: Hal and Watchdog drive the tree in SKYNET_HARDWARE_ROOT,
+ * as for skynet itself, or else an empty one. The settings, level history,
+ * alarm journal and boot profile go to a directory of their own removed at
+ * exit, not next to the test binary. Call before anything creates Hal, the
+ * Watchdog first of all, or reads the settings.
+ */
+inline void simulateHardware()
+{
+    static QTemporaryDir empty;
+    static QTemporaryDir data;
+
+    Settings::setDataDirectory(data.path());
+
+    if (qEnvironmentVariableIsSet("SKYNET_HARDWARE_ROOT"))
+        Hal::setHardwareRoot(QString::fromLocal8Bit(qgetenv("SKYNET_HARDWARE_ROOT")));
+    else
+        Hal::setHardwareRoot(empty.path());
+}
+
+#endif // SIMULATEDHARDWARE_H
@@ -0,0 +1,190 @@
+#include <QtTest>
+#include <QThread>
+
+#include "simulatedhardware.h"
+#include "watchdog.h"
+#include "settings.h"
+#include "watertower.h"
+
+/* stands in for MultiPointCom, emitting from another thread */
+class Emitter : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void fire()
+    {
+        emit responseReceived(0, reply);
+    }
+
+signals:
+    void responseReceived(char protocol, const QByteArray &data);
+
+public:
+    QByteArray reply;
+};
+
+class ThreadEmitter : public QThread
+{
+    Q_OBJECT
+
+signals:
+    void responseReceived(char protocol, const QByteArray &data);
+
+public:
+    QByteArray reply;
+
+protected:
+    virtual void run()
+    {
+        emit responseReceived(0, reply);
+    }
+};
+
+class Receiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    Receiver() : count(0) {}
+    int count;
+    QEventLoop loop;
+
+public slots:
+    void responseReceived(char protocol, const QByteArray &data)
+    {
+        Q_UNUSED(protocol);
+        Q_UNUSED(data);
+        count++;
+        loop.quit();
+    }
+};
+
+class WaterTowerBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void responseReceived_data();
+    void responseReceived();
+    void settingsLookup_data();
+    void settingsLookup();
+    void signalHop();
+    void threadSignalHop();
+
+private:
+    static QByteArray pulse(int level);
+};
+
+void WaterTowerBenchmark::initTestCase()
+{
+    /* created up front, MultiPointCom and the towers check in with it */
+    simulateHardware();
+    Watchdog::instance();
+}
+
+/* the reply of a node reporting level sensors, see the client simulator */
+QByteArray WaterTowerBenchmark::pulse(int level)
+{
+    quint32 usec = (level + 1) * 5000;
+    QByteArray data;
+    data.append(usec & 0xff);
+    data.append((usec >> 8) & 0xff);
+    data.append((usec >> 16) & 0xff);
+    data.append((usec >> 24) & 0xff);
+    return data;
+}
+
+void WaterTowerBenchmark::responseReceived_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::newRow("empty") << pulse(0);
+    QTest::newRow("half") << pulse(4);
+    QTest::newRow("full") << pulse(8);
+    QTest::newRow("rejected") << QByteArray(3, 0);
+}
+
+/*
+ * A reply from the radio up to the signal for the page: decoding the pulse
+ * plus what every reading sets off, the WaterLevelHistory append with a
+ * write and flush of its file, the alarm rules of the tower and the
+ * BootProfiler check. The history file dominates on a slow flash; it is in
+ * the temporary data directory of simulateHardware(). "rejected" is the
+ * decoding alone.
+ */
+void WaterTowerBenchmark::responseReceived()
+{
+    QFETCH(QByteArray, data);
+    WaterTower *tower = WaterTower::instance(0);
+
+    QBENCHMARK {
+        tower->responseReceived(0, data);
+    }
+}
+
+void WaterTowerBenchmark::settingsLookup_data()
+{
+    QTest::addColumn<QString>("key");
+    QTest::newRow("address") << "address";
+    QTest::newRow("enable") << "enable";
+    QTest::newRow("radius") << "radius";
+}
+
+/* the way WaterTower reads its options, a group per tower */
+void WaterTowerBenchmark::settingsLookup()
+{
+    QFETCH(QString, key);
+    WaterTower *tower = WaterTower::instance(1);
+
+    QBENCHMARK {
+        if (key == "address")
+            tower->getAddress();
+        else if (key == "enable")
+            tower->isEnabled();
+        else
+            tower->getRadius();
+    }
+}
+
+/* queued responseReceived from a long lived thread to the GUI thread */
+void WaterTowerBenchmark::signalHop()
+{
+    QThread thread;
+    Emitter emitter;
+    emitter.reply = pulse(4);
+    emitter.moveToThread(&thread);
+    Receiver receiver;
+    connect(&emitter, SIGNAL(responseReceived(char,QByteArray)), &receiver, SLOT(responseReceived(char,QByteArray)));
+    thread.start();
+
+    QBENCHMARK {
+        QMetaObject::invokeMethod(&emitter, "fire", Qt::QueuedConnection);
+        receiver.loop.exec();
+    }
+
+    thread.quit();
+    thread.wait();
+    QVERIFY(receiver.count > 0);
+}
+
+/* as MultiPointCom does it, a thread started for every request */
+void WaterTowerBenchmark::threadSignalHop()
+{
+    ThreadEmitter emitter;
+    emitter.reply = pulse(4);
+    Receiver receiver;
+    connect(&emitter, SIGNAL(responseReceived(char,QByteArray)), &receiver, SLOT(responseReceived(char,QByteArray)));
+
+    QBENCHMARK {
+        emitter.start();
+        receiver.loop.exec();
+        emitter.wait();
+    }
+
+    QVERIFY(receiver.count > 0);
+}
+
+QTEST_MAIN(WaterTowerBenchmark)
+
+#include "tst_watertower.moc"
@@ -0,0 +1,89 @@
+#include <QtTest>
+
+#include "simulatedhardware.h"
+#include "watchdog.h"
+#include "watertower.h"
+#include "watertowerwidget.h"
+#include "notifypanel.h"
+
+class WidgetsBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void waterLevelChanged_data();
+    void waterLevelChanged();
+    void addNotify_data();
+    void addNotify();
+};
+
+void WidgetsBenchmark::initTestCase()
+{
+    simulateHardware();
+    Watchdog::instance();
+}
+
+void WidgetsBenchmark::waterLevelChanged_data()
+{
+    QTest::addColumn<bool>("alternate");
+    QTest::newRow("same level") << false;
+    QTest::newRow("changing level") << true;
+}
+
+/* slot and synchronous repaint, what a reading costs the GUI thread */
+void WidgetsBenchmark::waterLevelChanged()
+{
+    QFETCH(bool, alternate);
+    WaterTowerWidget *widget = WaterTowerWidget::instance(0);
+    widget->show();
+    QVERIFY(QTest::qWaitForWindowExposed(widget));
+    widget->deviceConnect();
+
+    int height = WaterTower::instance(0)->getHeight();
+    int i = 0;
+    QBENCHMARK {
+        widget->waterLevelChanged(alternate && (i++ & 1) ? height : height / 2);
+        widget->repaint();
+    }
+    widget->hide();
+}
+
+void WidgetsBenchmark::addNotify_data()
+{
+    QTest::addColumn<int>("sources");
+    QTest::newRow("1 source") << 1;
+    QTest::newRow("16 sources") << 16;
+    QTest::newRow("256 sources") << 256;
+}
+
+/*
+ * An alarm storm: many sources raising and repeating at every priority.
+ * Besides the queueing, every call journals the raise or update with a write
+ * and a flush of AlarmJournal, which dominates on a slow flash; the journal
+ * is in the temporary data directory of simulateHardware().
+ */
+void WidgetsBenchmark::addNotify()
+{
+    QFETCH(int, sources);
+    NotifyPanel *panel = NotifyPanel::instance();
+
+    QStringList uuids;
+    for (int i = 0; i < sources; i++)
+        uuids << panel->uuid(QString("Benchmark-%1").arg(i));
+
+    /* already shown, so addNotify does not enter the modal exec() */
+    panel->show();
+
+    int i = 0;
+    QBENCHMARK {
+        int source = i++ % sources;
+        panel->addNotify(uuids.at(source), NotifyPanel::Priority(source % NotifyPanel::None),
+                         QString("Alarm %1").arg(source));
+    }
+    panel->hide();
+}
+
+QTEST_MAIN(WidgetsBenchmark)
+
+#include "tst_widgets.moc"
@@ -0,0 +1,9 @@
+QT       += testlib
+
+TARGET = tst_widgets
+CONFIG += testcase
+TEMPLATE = app
+
+include(../benchmarks.pri)
+
+SOURCES += tst_widgets.cpp
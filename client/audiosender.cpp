@@ -0,0 +1,162 @@
+#include <math.h>
+#include <string.h>
+
+#include <QUdpSocket>
+#include <QFile>
+#include <QTimer>
+#include <QtEndian>
+#include <QDebug>
+
+#include "audiosender.h"
+
+static const int SampleRate = 16000;
+static const int FrameSamples = 160;
+static const int FrameBytes = FrameSamples * 2;
+static const int FrameDuration = 10000;     /*  measured in the unit of "microsecond"  */
+static const int HeaderSize = 6;
+
+static const int TickInterval = 2;          /*  measured in the unit of "millisecond"  */
+static const int ReportInterval = 10;       /*  measured in the unit of "second"  */
+
+static double uniform()
+{
+    return (qrand() + 0.5) / (RAND_MAX + 1.0);
+}
+
+AudioSender::AudioSender(const QHostAddress &host, quint16 port, QObject *parent) :
+    QObject(parent),
+    host(host),
+    port(port),
+    loss(0),
+    jitter(0),
+    position(0),
+    sequence(0),
+    timestamp(0),
+    frames(0),
+    sent(0),
+    dropped(0)
+{
+    udp = new QUdpSocket(this);
+
+    tickTimer = new QTimer(this);
+    tickTimer->setTimerType(Qt::PreciseTimer);
+    connect(tickTimer, SIGNAL(timeout()), this, SLOT(tick()));
+
+    reportTimer = new QTimer(this);
+    connect(reportTimer, SIGNAL(timeout()), this, SLOT(report()));
+}
+
+/* 16 kHz mono 16 bit, a WAV file or raw samples */
+bool AudioSender::setFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Audio sender can not read" << fileName;
+        return false;
+    }
+    QByteArray content = file.readAll();
+
+    if (content.startsWith("RIFF") && content.mid(8, 4) == "WAVE") {
+        pcm.clear();
+        int offset = 12;
+        while (offset + 8 <= content.size()) {
+            const uchar *chunk = reinterpret_cast<const uchar *>(content.constData() + offset);
+            QByteArray id = content.mid(offset, 4);
+            int size = qFromLittleEndian<quint32>(chunk + 4);
+            if (size < 0)
+                break;
+            if (id == "fmt " && size >= 16) {
+                if (qFromLittleEndian<quint16>(chunk + 8) != 1
+                        || qFromLittleEndian<quint16>(chunk + 10) != 1
+                        || qFromLittleEndian<quint32>(chunk + 12) != quint32(SampleRate)
+                        || qFromLittleEndian<quint16>(chunk + 22) != 16) {
+                    qDebug() << "Audio sender needs 16 kHz mono 16 bit PCM," << fileName << "is not";
+                    return false;
+                }
+            } else if (id == "data") {
+                pcm = content.mid(offset + 8, size);
+                break;
+            }
+            offset += 8 + size + (size & 1);
+        }
+    } else {
+        pcm = content;
+    }
+
+    pcm.truncate(pcm.size() & ~1);
+    if (pcm.size() < FrameBytes) {
+        qDebug() << "Audio sender found no samples in" << fileName;
+        pcm.clear();
+        return false;
+    }
+    position = 0;
+    return true;
+}
+
+void AudioSender::start()
+{
+    qDebug() << "Audio sender streaming to" << host.toString() << port
+             << "loss" << loss << "jitter" << jitter << "ms";
+    clock.start();
+    tickTimer->start(TickInterval);
+    reportTimer->start(ReportInterval * 1000);
+}
+
+void AudioSender::tick()
+{
+    qint64 now = clock.nsecsElapsed() / 1000;
+
+    /* paced by the clock, a late tick catches up */
+    while (qint64(frames) * FrameDuration <= now) {
+        /* from the nominal send time, without jitter the keys keep the frames in order */
+        qint64 due = qint64(frames) * FrameDuration + qint64(uniform() * jitter * 1000);
+        QByteArray datagram(HeaderSize + FrameBytes, 0);
+        uchar *header = reinterpret_cast<uchar *>(datagram.data());
+        qToLittleEndian<quint16>(sequence, header);
+        qToLittleEndian<quint32>(timestamp, header + 2);
+        nextFrame(datagram.data() + HeaderSize);
+        sequence++;
+        timestamp += FrameSamples;
+        frames++;
+
+        if (uniform() < loss) {
+            dropped++;
+            continue;
+        }
+        pending.insert(due, datagram);
+    }
+
+    while (!pending.isEmpty() && pending.firstKey() <= now) {
+        udp->writeDatagram(pending.first(), host, port);
+        pending.erase(pending.begin());
+        sent++;
+    }
+}
+
+void AudioSender::report()
+{
+    qDebug() << "Audio sender" << frames << "frames," << sent << "sent," << dropped << "dropped";
+}
+
+void AudioSender::nextFrame(char *frame)
+{
+    if (!pcm.isEmpty()) {
+        for (int copied = 0; copied < FrameBytes; ) {
+            int chunk = qMin(FrameBytes - copied, pcm.size() - position);
+            memcpy(frame + copied, pcm.constData() + position, chunk);
+            copied += chunk;
+            position = (position + chunk) % pcm.size();
+        }
+        return;
+    }
+
+    /* a 440 Hz beep of 200 ms every second, gaps and clicks are easy to hear */
+    uchar *dest = reinterpret_cast<uchar *>(frame);
+    for (int i = 0; i < FrameSamples; i++) {
+        int sample = (timestamp + i) % SampleRate;
+        qint16 value = 0;
+        if (sample < SampleRate / 5)
+            value = qint16(8000 * sin(2 * M_PI * 440 * sample / SampleRate));
+        qToLittleEndian<qint16>(value, dest + 2 * i);
+    }
+}
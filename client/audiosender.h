@@ -0,0 +1,73 @@
+#ifndef AUDIOSENDER_H
+#define AUDIOSENDER_H
+
+#include <QObject>
+#include <QMap>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+class QUdpSocket;
+class QTimer;
+
+/*
+ * Stands in for a baby-care node streaming audio to the gateway.
+ *
+ * Every 10 ms a frame of 160 samples, 16 kHz mono signed 16 bit little
+ * endian, is sent in one datagram behind a little endian 16 bit sequence
+ * number and 32 bit sample timestamp. The samples come from a WAV or raw
+ * file of that format, looped, or a short beep every second. Frames can be
+ * dropped at random and delayed by up to a given jitter, which reorders
+ * them, to exercise the gateway's jitter buffer.
+ */
+class AudioSender : public QObject
+{
+    Q_OBJECT
+
+public:
+    AudioSender(const QHostAddress &host, quint16 port, QObject *parent = 0);
+
+    bool setFile(const QString &fileName);
+
+    void setLoss(double ratio)
+    {
+        loss = ratio;
+    }
+
+    /* measured in the unit of "millisecond" */
+    void setJitter(int msec)
+    {
+        jitter = msec;
+    }
+
+    void start();
+
+private slots:
+    void tick();
+    void report();
+
+private:
+    void nextFrame(char *frame);
+
+private:
+    QHostAddress host;
+    quint16 port;
+    double loss;
+    int jitter;
+
+    QByteArray pcm;             /*  empty for the beep  */
+    int position;
+
+    QUdpSocket *udp;
+    QTimer *tickTimer;
+    QTimer *reportTimer;
+    QElapsedTimer clock;
+    QMultiMap<qint64, QByteArray> pending;  /*  by due time, in microseconds on clock  */
+
+    quint16 sequence;
+    quint32 timestamp;
+    quint64 frames;
+    quint64 sent;
+    quint64 dropped;
+};
+
+#endif // AUDIOSENDER_H
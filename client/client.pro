@@ -13,8 +13,20 @@ TEMPLATE = app
 
 
 SOURCES += main.cpp\
-        mainwindow.cpp
+        mainwindow.cpp \
+    loadgenerator.cpp \
+    faultinjector.cpp \
+    scenario.cpp \
+    audiosender.cpp
 
-HEADERS  += mainwindow.h
+HEADERS  += mainwindow.h \
+    loadgenerator.h \
+    faultinjector.h \
+    scenario.h \
+    audiosender.h
 
 FORMS    += mainwindow.ui
+
+OTHER_FILES += \
+    loadtest.ini \
+    scenario.txt
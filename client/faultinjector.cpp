@@ -0,0 +1,69 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include <QSettings>
+
+#include "faultinjector.h"
+
+static const char *names[FaultInjector::KindCount] = {
+    "drop", "delay", "duplicate", "reorder", "corrupt", "wrongAddress"
+};
+
+FaultInjector::FaultInjector() :
+    enabled(false),
+    delayMsec(0),
+    corruptCount(1),
+    flapPeriod(0),
+    flapDown(0)
+{
+    for (int i = 0; i < KindCount; i++) {
+        faults[i].probability = 0;
+        faults[i].burst = 1;
+        faults[i].remaining = 0;
+    }
+}
+
+void FaultInjector::load(QSettings &settings)
+{
+    enabled = false;
+    for (int i = 0; i < KindCount; i++) {
+        QString key = names[i];
+        faults[i].probability = qBound(0.0, settings.value(key, 0).toDouble(), 1.0);
+        faults[i].burst = qMax(1, settings.value(key + "Burst", 1).toInt());
+        faults[i].remaining = 0;
+        enabled |= faults[i].probability > 0;
+    }
+
+    delayMsec = settings.value("delayTime", 80).toDouble();
+    corruptCount = qMax(1, settings.value("corruptBytes", 1).toInt());
+    flapPeriod = settings.value("flapPeriod", 0).toDouble();
+    flapDown = settings.value("flapDown", 0).toDouble();
+    enabled |= flapPeriod > 0 && flapDown > 0;
+}
+
+bool FaultInjector::trigger(Kind kind)
+{
+    Fault &fault = faults[kind];
+    if (fault.remaining > 0) {
+        fault.remaining--;
+        return true;
+    }
+    if (fault.probability > 0 && (qrand() + 0.5) / (RAND_MAX + 1.0) < fault.probability) {
+        fault.remaining = fault.burst - 1;
+        return true;
+    }
+    return false;
+}
+
+bool FaultInjector::isDown(double second) const
+{
+    if (flapPeriod <= 0 || flapDown <= 0)
+        return false;
+    return fmod(second, flapPeriod) >= flapPeriod - flapDown;
+}
+
+/* static */
+const char *FaultInjector::name(Kind kind)
+{
+    return names[kind];
+}
@@ -0,0 +1,73 @@
+#ifndef FAULTINJECTOR_H
+#define FAULTINJECTOR_H
+
+class QSettings;
+
+/*
+ * Faults injected into the replies of the load generator.
+ *
+ * Each kind has a probability that a burst starts on a reply and the burst
+ * length, the number of consecutive replies it then affects. Keys, read from
+ * the current settings group:
+ *
+ *   drop=0.05, dropBurst=3
+ *   delay=0.1, delayBurst=1, delayTime=80          milliseconds added
+ *   duplicate=0.01, duplicateBurst=1
+ *   reorder=0.01, reorderBurst=1                   held back, sent after the next reply
+ *   corrupt=0.01, corruptBurst=1, corruptBytes=1   random payload bytes replaced
+ *   wrongAddress=0.01, wrongAddressBurst=1
+ *   flapPeriod=600, flapDown=60                    seconds absent at the end of each period
+ */
+class FaultInjector
+{
+public:
+    enum Kind {
+        Drop,
+        Delay,
+        Duplicate,
+        Reorder,
+        Corrupt,
+        WrongAddress,
+        KindCount
+    };
+
+    FaultInjector();
+
+    void load(QSettings &settings);
+
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    bool trigger(Kind kind);
+    bool isDown(double second) const;
+
+    double delayTime() const
+    {
+        return delayMsec;
+    }
+
+    int corruptBytes() const
+    {
+        return corruptCount;
+    }
+
+    static const char *name(Kind kind);
+
+private:
+    struct Fault {
+        double probability;
+        int burst;
+        int remaining;
+    };
+
+    bool enabled;
+    Fault faults[KindCount];
+    double delayMsec;
+    int corruptCount;
+    double flapPeriod;      /*  measured in the unit of "second"  */
+    double flapDown;
+};
+
+#endif // FAULTINJECTOR_H
@@ -0,0 +1,388 @@
+#include <math.h>
+
+#include <QUdpSocket>
+#include <QFile>
+#include <QSettings>
+#include <QStringList>
+#include <QTimer>
+#include <QTextStream>
+#include <QDebug>
+
+#include "loadgenerator.h"
+
+/* a reordered reply waits this long for a later one to overtake it */
+static const int ReorderHold = 200;
+
+static double uniform()
+{
+    return (qrand() + 0.5) / (RAND_MAX + 1.0);
+}
+
+LoadGenerator::LoadGenerator(const QString &fileName, QObject *parent) :
+    QObject(parent),
+    fileName(fileName),
+    nodes(256),
+    speed(1),
+    speedOverride(0),
+    holding(false),
+    received(0),
+    answered(0),
+    ignored(0),
+    lastReceived(0),
+    flapped(0),
+    maxPending(0)
+{
+    for (int i = 0; i < FaultInjector::KindCount; i++)
+        injected[i] = 0;
+
+    for (int i = 0; i < nodes.count(); i++) {
+        nodes[i].configured = false;
+        nodes[i].present = false;
+    }
+
+    udp = new QUdpSocket(this);
+    connect(udp, SIGNAL(readyRead()), this, SLOT(readPendingDatagrams()));
+
+    replyTimer = new QTimer(this);
+    replyTimer->setSingleShot(true);
+    replyTimer->setTimerType(Qt::PreciseTimer);
+    connect(replyTimer, SIGNAL(timeout()), this, SLOT(sendDueReplies()));
+
+    holdTimer = new QTimer(this);
+    holdTimer->setSingleShot(true);
+    connect(holdTimer, SIGNAL(timeout()), this, SLOT(releaseHeld()));
+
+    reportTimer = new QTimer(this);
+    connect(reportTimer, SIGNAL(timeout()), this, SLOT(report()));
+}
+
+bool LoadGenerator::start()
+{
+    QSettings settings(fileName, QSettings::IniFormat);
+    if (!QFile::exists(fileName) || settings.status() != QSettings::NoError) {
+        qDebug() << "Load generator can not read" << fileName;
+        return false;
+    }
+
+    port = settings.value("port", 19999).toUInt();
+    batch = qMax(1, settings.value("batch", 64).toInt());
+    reportInterval = settings.value("report", 10).toInt();
+    loadNodes(settings);
+    settings.beginGroup("Faults");
+    globalFaults.load(settings);
+    settings.endGroup();
+
+    QString scenarioFile = settings.value("scenario").toString();
+    if (!scenarioFile.isEmpty()) {
+        QString error;
+        if (!scenario.load(scenarioFile, &error)) {
+            qDebug() << "Load generator scenario" << error;
+            return false;
+        }
+        for (int address = 0; address < nodes.count(); address++) {
+            if (!scenario.contains(address))
+                continue;
+            if (!nodes.at(address).configured) {
+                settings.beginGroup("Scenario");
+                readNode(settings, nodes[address]);
+                settings.endGroup();
+            }
+            nodes[address].waveform = Scripted;
+        }
+        speed = scenario.speed();
+    }
+    speed = settings.value("speed", speed).toDouble();
+    if (speedOverride > 0)
+        speed = speedOverride;
+
+    if (!udp->bind(QHostAddress::LocalHost, port)) {
+        qDebug() << "Load generator can not bind" << port << udp->errorString();
+        return false;
+    }
+
+    qsrand(settings.value("seed", 1).toUInt());
+    clock.start();
+    if (reportInterval > 0)
+        reportTimer->start(reportInterval * 1000);
+    return true;
+}
+
+/* "0x10-0x1f,0x30,64" */
+QList<int> LoadGenerator::parseAddresses(const QString &text)
+{
+    QList<int> addresses;
+    foreach (const QString &part, text.split(',', QString::SkipEmptyParts)) {
+        QStringList bounds = part.trimmed().split('-');
+        bool ok1, ok2;
+        int first = bounds.first().trimmed().toInt(&ok1, 0);
+        int last = bounds.last().trimmed().toInt(&ok2, 0);
+        if (!ok1 || !ok2 || bounds.count() > 2)
+            continue;
+        for (int address = qMax(first, 0); address <= qMin(last, 255); address++)
+            addresses.append(address);
+    }
+    return addresses;
+}
+
+/*
+ * Same pulse width a real node reports, 5 ms per sensor level; a level
+ * between two sensors gives a width between theirs.
+ */
+QByteArray LoadGenerator::encodeLevel(quint8 address, double level)
+{
+    quint32 usec = qRound((qBound(0.0, level, Scenario::Overflow) + 1) * 5000);
+    QByteArray data;
+    data.append(address);
+    data.append('\0');
+    data.append((usec >> 0) & 0xFF);
+    data.append((usec >> 8) & 0xFF);
+    data.append((usec >> 16) & 0xFF);
+    data.append((usec >> 24) & 0xFF);
+    return data;
+}
+
+void LoadGenerator::readPendingDatagrams()
+{
+    QByteArray data;
+    QHostAddress sender;
+    quint16 senderPort;
+
+    for (int i = 0; i < batch && udp->hasPendingDatagrams(); i++) {
+        data.resize(udp->pendingDatagramSize());
+        udp->readDatagram(data.data(), data.size(), &sender, &senderPort);
+        received++;
+
+        if (data.isEmpty()) {
+            ignored++;
+            continue;
+        }
+
+        quint8 address = data.at(0);
+        Node &node = nodes[address];
+        if (!node.configured || !node.present) {
+            ignored++;
+            continue;
+        }
+
+        double second = clock.elapsed() / 1000.0;
+        if (node.faults.isDown(second + node.phase) || globalFaults.isDown(second)) {
+            flapped++;
+            continue;
+        }
+        if (inject(node, FaultInjector::Drop))
+            continue;
+
+        Reply reply;
+        reply.data = encodeLevel(address, levelOf(address, node, second));
+        reply.host = sender;
+        reply.port = senderPort;
+        reply.reorder = inject(node, FaultInjector::Reorder);
+
+        double delay = latencyOf(node);
+        if (inject(node, FaultInjector::Delay))
+            delay += qMax(node.faults.delayTime(), globalFaults.delayTime());
+        if (inject(node, FaultInjector::Corrupt)) {
+            int bytes = qMax(node.faults.corruptBytes(), globalFaults.corruptBytes());
+            for (int b = 0; b < bytes; b++)
+                reply.data[2 + qrand() % (reply.data.size() - 2)] = char(qrand());
+        }
+        if (inject(node, FaultInjector::WrongAddress))
+            reply.data[0] = char(address ^ (1 + qrand() % 255));
+
+        schedule(reply, delay);
+        if (inject(node, FaultInjector::Duplicate)) {
+            reply.reorder = false;
+            schedule(reply, delay + 1);
+        }
+    }
+
+    /* let timers run between batches, pick up the rest in the next pass */
+    if (udp->hasPendingDatagrams())
+        QTimer::singleShot(0, this, SLOT(readPendingDatagrams()));
+}
+
+void LoadGenerator::sendDueReplies()
+{
+    qint64 now = clock.nsecsElapsed() / 1000;
+    while (!pending.isEmpty() && pending.begin().key() <= now) {
+        Reply reply = pending.begin().value();
+        pending.erase(pending.begin());
+        send(reply);
+    }
+
+    if (!pending.isEmpty())
+        replyTimer->start(qMax(Q_INT64_C(0), (pending.begin().key() - now) / 1000));
+}
+
+void LoadGenerator::releaseHeld()
+{
+    if (holding) {
+        holding = false;
+        udp->writeDatagram(held.data, held.host, held.port);
+        answered++;
+    }
+}
+
+void LoadGenerator::report()
+{
+    QTextStream out(stdout);
+    out << "elapsed " << clock.elapsed() / 1000
+        << " received " << received
+        << " answered " << answered
+        << " ignored " << ignored
+        << " rate " << (received - lastReceived) / double(reportInterval) << "/s"
+        << " max-pending " << maxPending
+        << " flapped " << flapped;
+    for (int i = 0; i < FaultInjector::KindCount; i++)
+        out << " " << FaultInjector::name(FaultInjector::Kind(i)) << " " << injected[i];
+    out << endl;
+    lastReceived = received;
+    maxPending = pending.count();
+}
+
+void LoadGenerator::loadNodes(QSettings &settings)
+{
+    foreach (const QString &group, settings.childGroups()) {
+        if (!group.startsWith("Node-"))
+            continue;
+
+        settings.beginGroup(group);
+        Node node;
+        readNode(settings, node);
+        QList<int> addresses = parseAddresses(settings.value("addresses").toString());
+        for (int i = 0; i < addresses.count(); i++) {
+            /* spread the nodes of a group over one period */
+            node.phase = node.period * i / addresses.count();
+            nodes[addresses.at(i)] = node;
+        }
+        settings.endGroup();
+
+        qDebug() << group << addresses.count() << "node(s)";
+    }
+}
+
+/* from the current group, missing keys give the defaults */
+void LoadGenerator::readNode(QSettings &settings, Node &node)
+{
+    node.configured = true;
+    node.present = settings.value("present", true).toBool();
+
+    QString waveform = settings.value("waveform", "constant").toString();
+    node.waveform = waveform == "sine" ? Sine
+            : waveform == "square" ? Square
+            : waveform == "sawtooth" ? Sawtooth
+            : waveform == "random" ? Random
+            : Constant;
+    node.level = settings.value("level", 0).toDouble();
+    node.minimum = settings.value("minimum", 0).toDouble();
+    node.maximum = settings.value("maximum", 8).toDouble();
+    node.period = qMax(1.0, settings.value("period", 60).toDouble());
+
+    QString latency = settings.value("latency", "fixed").toString();
+    node.latency = latency == "uniform" ? Uniform
+            : latency == "normal" ? Normal
+            : latency == "exponential" ? Exponential
+            : Fixed;
+    node.latencyMean = settings.value("latencyMean", 2).toDouble();
+    node.latencySpread = settings.value("latencySpread", 0).toDouble();
+    node.faults.load(settings);
+    node.phase = 0;
+}
+
+double LoadGenerator::levelOf(int address, const Node &node, double second) const
+{
+    if (node.waveform == Scripted)
+        return scenario.level(address, second * speed);
+
+    double position = fmod(second + node.phase, node.period) / node.period;
+    double span = node.maximum - node.minimum;
+    double level;
+
+    switch (node.waveform) {
+    case Sine:
+        level = node.minimum + span * (0.5 - 0.5 * cos(2 * M_PI * position));
+        break;
+    case Square:
+        level = position < 0.5 ? node.minimum : node.maximum;
+        break;
+    case Sawtooth:
+        level = node.minimum + span * position;
+        break;
+    case Random:
+        level = node.minimum + span * uniform();
+        break;
+    default:
+        level = node.level;
+        break;
+    }
+
+    return qBound(0.0, level, 8.0);
+}
+
+double LoadGenerator::latencyOf(const Node &node) const
+{
+    double latency;
+
+    switch (node.latency) {
+    case Uniform:
+        latency = node.latencyMean + node.latencySpread * (2 * uniform() - 1);
+        break;
+    case Normal:
+        /* Box-Muller */
+        latency = node.latencyMean + node.latencySpread * sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+        break;
+    case Exponential:
+        latency = -node.latencyMean * log(uniform());
+        break;
+    default:
+        latency = node.latencyMean;
+        break;
+    }
+
+    return qMax(0.0, latency);
+}
+
+/* node faults first, a burst of the global ones affects every node */
+bool LoadGenerator::inject(Node &node, FaultInjector::Kind kind)
+{
+    if (node.faults.trigger(kind) || globalFaults.trigger(kind)) {
+        injected[kind]++;
+        return true;
+    }
+    return false;
+}
+
+/* delay measured in the unit of "millisecond" */
+void LoadGenerator::schedule(const Reply &reply, double delay)
+{
+    if (delay <= 0) {
+        send(reply);
+        return;
+    }
+
+    qint64 due = clock.nsecsElapsed() / 1000 + qint64(delay * 1000);
+    pending.insert(due, reply);
+    maxPending = qMax(maxPending, pending.count());
+
+    if (pending.begin().key() == due)
+        replyTimer->start(qMax(Q_INT64_C(0), qint64(delay)));
+}
+
+void LoadGenerator::send(const Reply &reply)
+{
+    if (reply.reorder && !holding) {
+        held = reply;
+        holding = true;
+        holdTimer->start(ReorderHold);
+        return;
+    }
+
+    udp->writeDatagram(reply.data, reply.host, reply.port);
+    answered++;
+
+    /* the held reply goes out right behind the one that overtook it */
+    if (holding) {
+        holdTimer->stop();
+        releaseHeld();
+    }
+}
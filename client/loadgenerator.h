@@ -0,0 +1,144 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QObject>
+#include <QVector>
+#include <QMap>
+#include <QHostAddress>
+#include <QElapsedTimer>
+
+#include "faultinjector.h"
+#include "scenario.h"
+
+class QUdpSocket;
+class QTimer;
+class QSettings;
+
+/*
+ * Headless node simulator driven by an ini file instead of the widgets.
+ *
+ * Every [Node-*] group configures a set of node addresses:
+ *
+ *   addresses=0x10-0x7f,0x90   address bytes as sent by the gateway
+ *   present=true               answer at all
+ *   waveform=sine              constant, sine, square, sawtooth or random
+ *   level=4                    constant level, in sensors (0..8)
+ *   minimum=0, maximum=8       range of the other waveforms
+ *   period=60                  seconds, nodes of a group are spread over it
+ *   latency=uniform            fixed, uniform, normal or exponential
+ *   latencyMean=2              milliseconds
+ *   latencySpread=1            half width, standard deviation or unused
+ *
+ * Faults are configured with the FaultInjector keys, per [Node-*] group and
+ * for all nodes at once in [Faults].
+ *
+ * [General] holds port (19999), batch (datagrams read per pass before the
+ * event loop gets to run, 64), report (seconds between statistics, 10),
+ * scenario (a Scenario file) and speed (its playback speed, 1 is real
+ * time). Nodes in the scenario follow it instead of their waveform, those
+ * without a [Node-*] group take latency and faults from [Scenario].
+ * The gateway addresses a node with one byte, so one simulator covers at
+ * most 256 nodes.
+ */
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Waveform {
+        Constant,
+        Sine,
+        Square,
+        Sawtooth,
+        Random,
+        Scripted
+    };
+
+    enum Latency {
+        Fixed,
+        Uniform,
+        Normal,
+        Exponential
+    };
+
+    struct Node {
+        bool configured;
+        bool present;
+        Waveform waveform;
+        double level;
+        double minimum;
+        double maximum;
+        double period;          /*  measured in the unit of "second"  */
+        double phase;
+        Latency latency;
+        double latencyMean;     /*  measured in the unit of "millisecond"  */
+        double latencySpread;
+        FaultInjector faults;
+    };
+
+    explicit LoadGenerator(const QString &fileName, QObject *parent = 0);
+
+    bool start();
+
+    /* 0 keeps the speed of the configuration or the scenario */
+    void setSpeed(double factor)
+    {
+        speedOverride = factor;
+    }
+
+    static QList<int> parseAddresses(const QString &text);
+    static QByteArray encodeLevel(quint8 address, double level);
+
+private slots:
+    void readPendingDatagrams();
+    void sendDueReplies();
+    void releaseHeld();
+    void report();
+
+private:
+    struct Reply {
+        QByteArray data;
+        QHostAddress host;
+        quint16 port;
+        bool reorder;
+    };
+
+    void loadNodes(QSettings &settings);
+    void readNode(QSettings &settings, Node &node);
+    double levelOf(int address, const Node &node, double second) const;
+    double latencyOf(const Node &node) const;
+    bool inject(Node &node, FaultInjector::Kind kind);
+    void schedule(const Reply &reply, double delay);
+    void send(const Reply &reply);
+
+private:
+    QString fileName;
+    QVector<Node> nodes;        /*  indexed by address byte  */
+    FaultInjector globalFaults;
+    Scenario scenario;
+    double speed;
+    double speedOverride;
+
+    quint16 port;
+    int batch;
+    int reportInterval;
+
+    QUdpSocket *udp;
+    QTimer *replyTimer;
+    QTimer *reportTimer;
+    QElapsedTimer clock;
+    QMultiMap<qint64, Reply> pending;   /*  by due time, in microseconds on clock  */
+    QTimer *holdTimer;
+    Reply held;
+    bool holding;
+
+    quint64 received;
+    quint64 answered;
+    quint64 ignored;
+    quint64 lastReceived;
+    quint64 flapped;
+    quint64 injected[FaultInjector::KindCount];
+    int maxPending;
+};
+
+#endif // LOADGENERATOR_H
@@ -1,11 +1,67 @@
 #include "mainwindow.h"
+#include "loadgenerator.h"
+#include "audiosender.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QScopedPointer>
+#include <QString>
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    /* the headless mode must not need a display, decide before the application exists */
+    bool headless = false;
+    for (int i = 1; i < argc; i++) {
+        if (QString(argv[i]) == "--headless" || QString(argv[i]) == "--audio-sender")
+            headless = true;
+    }
+
+    QScopedPointer<QCoreApplication> a(headless ? new QCoreApplication(argc, argv)
+                                                : new QApplication(argc, argv));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption headlessOption("headless",
+            "Simulate the nodes described by <config> without a window, see loadtest.ini.", "config");
+    parser.addOption(headlessOption);
+    QCommandLineOption speedOption("speed",
+            "Play the scenario <factor> times faster than real time.", "factor");
+    parser.addOption(speedOption);
+    QCommandLineOption audioSenderOption("audio-sender",
+            "Stream baby-care audio to the gateway at <host:port> without a window.", "host:port");
+    parser.addOption(audioSenderOption);
+    QCommandLineOption audioFileOption("audio-file",
+            "Stream <file>, 16 kHz mono 16 bit WAV or raw, instead of a beep.", "file");
+    parser.addOption(audioFileOption);
+    QCommandLineOption audioLossOption("audio-loss",
+            "Drop <percent> of the audio frames at random.", "percent");
+    parser.addOption(audioLossOption);
+    QCommandLineOption audioJitterOption("audio-jitter",
+            "Delay every audio frame by up to <ms> at random.", "ms");
+    parser.addOption(audioJitterOption);
+    parser.process(*a);
+
+    if (parser.isSet(audioSenderOption)) {
+        QString target = parser.value(audioSenderOption);
+        AudioSender sender(QHostAddress(target.section(':', 0, 0)), target.section(':', 1, 1).toUShort());
+        if (parser.isSet(audioFileOption) && !sender.setFile(parser.value(audioFileOption)))
+            return 1;
+        sender.setLoss(parser.value(audioLossOption).toDouble() / 100);
+        sender.setJitter(parser.value(audioJitterOption).toInt());
+        sender.start();
+        return a->exec();
+    }
+
+    if (headless) {
+        LoadGenerator generator(parser.value(headlessOption));
+        if (parser.isSet(speedOption))
+            generator.setSpeed(parser.value(speedOption).toDouble());
+        if (!generator.start())
+            return 1;
+        return a->exec();
+    }
+
     MainWindow w;
     w.show();
 
-    return a.exec();
+    return a->exec();
 }
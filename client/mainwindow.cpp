@@ -84,6 +84,7 @@ void MainWindow::readPendingDatagrams()
                 value = ui->horizontalSlider5->value();
                 break;
             default:
+                isConnected = false;
                 value = 0;
                 break;
             }
@@ -0,0 +1,148 @@
+#include <math.h>
+
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QHash>
+
+#include "loadgenerator.h"
+#include "scenario.h"
+
+/* above the top sensor, still short of the 60 ms the gateway rejects */
+const double Scenario::Overflow = 9.5;
+
+Scenario::Scenario() :
+    trackOf(256, -1),
+    defaultSpeed(1)
+{
+}
+
+bool Scenario::load(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *error = fileName + ": can not be opened";
+        return false;
+    }
+
+    Track *track = 0;
+    QTextStream in(&file);
+    for (int number = 1; !in.atEnd(); number++) {
+        QString line = in.readLine();
+        line = line.left(line.indexOf('#')).trimmed();
+        if (line.isEmpty())
+            continue;
+
+        QStringList words = line.split(QRegExp("\\s+"));
+        QString keyword = words.takeFirst();
+
+        /* the rest are a leading number followed by name value pairs */
+        bool ok = true;
+        double count = words.isEmpty() ? 0 : words.first().toDouble(&ok);
+        QHash<QString, double> args;
+        for (int i = 1; ok && i + 1 < words.count(); i += 2)
+            args.insert(words.at(i), words.at(i + 1).toDouble(&ok));
+
+        if (keyword == "speed" && ok && count > 0) {
+            defaultSpeed = count;
+            continue;
+        }
+
+        if (keyword == "node") {
+            QList<int> addresses = LoadGenerator::parseAddresses(words.join(","));
+            if (addresses.isEmpty()) {
+                *error = QString("%1:%2: no address").arg(fileName).arg(number);
+                return false;
+            }
+            tracks.append(Track());
+            track = &tracks.last();
+            track->length = 0;
+            track->loop = false;
+            foreach (int address, addresses)
+                trackOf[address] = tracks.count() - 1;
+            continue;
+        }
+
+        if (!track || !ok) {
+            *error = QString("%1:%2: %3").arg(fileName).arg(number).arg(track ? "bad number" : "node expected");
+            return false;
+        }
+
+        double current = track->segments.isEmpty() ? 0 : track->segments.last().to;
+        if (keyword == "set") {
+            append(*track, 0, count);
+        } else if (keyword == "ramp" && args.contains("to")) {
+            append(*track, count, args.value("to"));
+        } else if (keyword == "hold") {
+            append(*track, count, current);
+        } else if (keyword == "pump" && args.contains("fill") && args.contains("drain")) {
+            for (int i = 0; i < int(count); i++) {
+                append(*track, args.value("fill"), args.value("high", 8));
+                append(*track, args.value("drain"), args.value("low", 0));
+            }
+        } else if (keyword == "leak" && args.contains("rate")) {
+            append(*track, count, qMax(0.0, current + args.value("rate") * count / 3600));
+        } else if (keyword == "stuck") {
+            track->stuck.append(qMakePair(track->length, track->length + count));
+        } else if (keyword == "overflow") {
+            append(*track, 0, Overflow);
+            append(*track, count, Overflow);
+            append(*track, 0, current);
+        } else if (keyword == "loop") {
+            track->loop = true;
+        } else {
+            *error = QString("%1:%2: unknown or incomplete \"%3\"").arg(fileName).arg(number).arg(keyword);
+            return false;
+        }
+    }
+
+    if (tracks.isEmpty()) {
+        *error = fileName + ": no node";
+        return false;
+    }
+    return true;
+}
+
+double Scenario::level(int address, double second) const
+{
+    const Track &track = tracks.at(trackOf.at(address));
+    if (track.segments.isEmpty())
+        return 0;
+
+    if (track.loop && track.length > 0)
+        second = fmod(second, track.length);
+
+    for (int i = 0; i < track.stuck.count(); i++) {
+        if (second >= track.stuck.at(i).first && second < track.stuck.at(i).second) {
+            second = track.stuck.at(i).first;
+            break;
+        }
+    }
+
+    /* last segment starting at or before second */
+    int low = 0, high = track.segments.count();
+    while (high - low > 1) {
+        int middle = (low + high) / 2;
+        if (track.segments.at(middle).start <= second)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    const Segment &segment = track.segments.at(low);
+    if (second >= segment.start + segment.duration || segment.duration <= 0)
+        return segment.to;
+    return segment.from + (segment.to - segment.from) * (second - segment.start) / segment.duration;
+}
+
+/* static */
+void Scenario::append(Track &track, double duration, double to)
+{
+    Segment segment;
+    segment.start = track.length;
+    segment.duration = qMax(0.0, duration);
+    segment.from = track.segments.isEmpty() ? to : track.segments.last().to;
+    segment.to = to;
+    track.segments.append(segment);
+    track.length += segment.duration;
+}
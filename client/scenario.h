@@ -0,0 +1,70 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <QString>
+#include <QVector>
+#include <QPair>
+
+/*
+ * Scripted water level over time, one track per group of node addresses.
+ * Levels are in sensors, fractions are encoded as the pulse width between
+ * two sensors the way the real node does. Lines, '#' starts a comment:
+ *
+ *   speed 60                       default playback speed, 1 is real time
+ *   node 0x10-0x13,0x20            following lines describe these nodes
+ *   set 2                          jump to a level
+ *   ramp 600 to 8                  fill or drain linearly over 600 s
+ *   hold 120                       keep the level for 120 s
+ *   pump 5 fill 300 drain 120 low 2 high 7
+ *                                  5 cycles of filling to high, draining to low
+ *   leak 3600 rate -0.5            sensors per hour, for 3600 s
+ *   stuck 600                      reported level frozen for 600 s from here,
+ *                                  while the track itself goes on
+ *   overflow 60                    above the top sensor for 60 s, then back
+ *   loop                           repeat the track once it ends
+ */
+class Scenario
+{
+public:
+    Scenario();
+
+    bool load(const QString &fileName, QString *error);
+
+    bool contains(int address) const
+    {
+        return address >= 0 && address < trackOf.count() && trackOf.at(address) >= 0;
+    }
+
+    double level(int address, double second) const;
+
+    double speed() const
+    {
+        return defaultSpeed;
+    }
+
+    static const double Overflow;
+
+private:
+    struct Segment {
+        double start;       /*  measured in the unit of "second"  */
+        double duration;
+        double from;
+        double to;
+    };
+
+    struct Track {
+        QVector<Segment> segments;
+        QVector<QPair<double, double> > stuck;  /*  start and end  */
+        double length;
+        bool loop;
+    };
+
+    static void append(Track &track, double duration, double to);
+
+private:
+    QVector<int> trackOf;   /*  track index by address byte, -1 for none  */
+    QVector<Track> tracks;
+    double defaultSpeed;
+};
+
+#endif // SCENARIO_H
@@ -1,8 +1,792 @@
+#include <math.h>
+
+#include <QApplication>
+#include <QTimer>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <QDebug>
+
+#include "settings.h"
+#include "watertower.h"
 #include "alarmcontroller.h"
 
+AlarmController *AlarmController::self = 0;
+
+static const int TickInterval = 1000;
+
+static bool truth(double value)
+{
+    /* NaN, a tower without a reading, is false whatever it is compared to */
+    return value == value && value != 0;
+}
+
+/*
+ * Recursive descent over the rule expression, emitting the postfix program
+ * while it goes:
+ *
+ *   or      := and (("or" | "||") and)*
+ *   and     := not (("and" | "&&") not)*
+ *   not     := ("not" | "!") not | compare
+ *   compare := sum (("<" | "<=" | ">" | ">=" | "==" | "!=") sum)?
+ *   sum     := product (("+" | "-") product)*
+ *   product := unary (("*" | "/") unary)*
+ *   unary   := "-" unary | number | name "(" tower ")" | "(" or ")"
+ */
+class RuleCompiler
+{
+public:
+    RuleCompiler(const QString &text, AlarmController::Program *program) :
+        text(text),
+        position(0),
+        program(program)
+    {
+    }
+
+    bool compile(QString *error)
+    {
+        next();
+        parseOr();
+        if (message.isEmpty() && !token.isEmpty())
+            fail("unexpected " + token);
+        if (!message.isEmpty() && error)
+            *error = message;
+        return message.isEmpty();
+    }
+
+private:
+    void next()
+    {
+        while (position < text.size() && text.at(position).isSpace())
+            position++;
+        token.clear();
+        if (position >= text.size())
+            return;
+
+        QChar c = text.at(position);
+        if (c.isDigit() || c == '.') {
+            while (position < text.size() && (text.at(position).isDigit() || text.at(position) == '.'))
+                token += text.at(position++);
+        } else if (c.isLetter()) {
+            while (position < text.size() && text.at(position).isLetterOrNumber())
+                token += text.at(position++);
+            token = token.toLower();
+        } else {
+            static const char *pairs[] = { "<=", ">=", "==", "!=", "&&", "||" };
+            for (unsigned i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+                if (text.midRef(position, 2) == QLatin1String(pairs[i])) {
+                    token = pairs[i];
+                    position += 2;
+                    return;
+                }
+            }
+            token = c;
+            position++;
+        }
+    }
+
+    void append(AlarmController::Operation operation, int tower = -1, double value = 0)
+    {
+        AlarmController::Instruction instruction;
+        instruction.operation = operation;
+        instruction.tower = tower;
+        instruction.value = value;
+        program->append(instruction);
+    }
+
+    void fail(const QString &what)
+    {
+        if (message.isEmpty())
+            message = QString("%1 at %2").arg(what).arg(position);
+        token.clear();
+    }
+
+    void expect(const QString &expected)
+    {
+        if (token != expected)
+            fail("expected " + expected);
+        else
+            next();
+    }
+
+    void parseOr()
+    {
+        parseAnd();
+        while (token == "or" || token == "||") {
+            next();
+            parseAnd();
+            append(AlarmController::Or);
+        }
+    }
+
+    void parseAnd()
+    {
+        parseNot();
+        while (token == "and" || token == "&&") {
+            next();
+            parseNot();
+            append(AlarmController::And);
+        }
+    }
+
+    void parseNot()
+    {
+        if (token == "not" || token == "!") {
+            next();
+            parseNot();
+            append(AlarmController::Not);
+            return;
+        }
+        parseCompare();
+    }
+
+    void parseCompare()
+    {
+        static const struct {
+            const char *token;
+            AlarmController::Operation operation;
+        } comparisons[] = {
+            { "<", AlarmController::Less },
+            { "<=", AlarmController::LessEqual },
+            { ">", AlarmController::Greater },
+            { ">=", AlarmController::GreaterEqual },
+            { "==", AlarmController::Equal },
+            { "!=", AlarmController::NotEqual }
+        };
+
+        parseSum();
+        for (unsigned i = 0; i < sizeof(comparisons) / sizeof(comparisons[0]); i++) {
+            if (token == comparisons[i].token) {
+                next();
+                parseSum();
+                append(comparisons[i].operation);
+                return;
+            }
+        }
+    }
+
+    void parseSum()
+    {
+        parseProduct();
+        while (token == "+" || token == "-") {
+            AlarmController::Operation operation = token == "+" ? AlarmController::Add : AlarmController::Subtract;
+            next();
+            parseProduct();
+            append(operation);
+        }
+    }
+
+    void parseProduct()
+    {
+        parseUnary();
+        while (token == "*" || token == "/") {
+            AlarmController::Operation operation = token == "*" ? AlarmController::Multiply : AlarmController::Divide;
+            next();
+            parseUnary();
+            append(operation);
+        }
+    }
+
+    void parseUnary()
+    {
+        static const struct {
+            const char *name;
+            AlarmController::Operation operation;
+        } functions[] = {
+            { "level", AlarmController::Level },
+            { "height", AlarmController::Height },
+            { "step", AlarmController::Step },
+            { "percent", AlarmController::Percent },
+            { "rate", AlarmController::Rate },
+            { "offline", AlarmController::Offline },
+            { "online", AlarmController::Online }
+        };
+
+        if (token == "-") {
+            next();
+            parseUnary();
+            append(AlarmController::Negate);
+        } else if (token == "(") {
+            next();
+            parseOr();
+            expect(")");
+        } else if (!token.isEmpty() && (token.at(0).isDigit() || token.at(0) == '.')) {
+            bool ok;
+            double value = token.toDouble(&ok);
+            if (!ok)
+                fail("bad number " + token);
+            append(AlarmController::Constant, -1, value);
+            next();
+        } else {
+            for (unsigned i = 0; i < sizeof(functions) / sizeof(functions[0]); i++) {
+                if (token == functions[i].name) {
+                    next();
+                    expect("(");
+                    bool ok;
+                    int tower = token.toInt(&ok);
+                    if (!ok || tower < 0 || tower >= WaterTower::MaxQuantity)
+                        fail("no tower " + token);
+                    next();
+                    expect(")");
+                    append(functions[i].operation, tower);
+                    return;
+                }
+            }
+            fail(token.isEmpty() ? QString("unexpected end") : "unknown " + token);
+        }
+    }
+
+private:
+    QString text;
+    int position;
+    QString token;
+    QString message;
+    AlarmController::Program *program;
+};
+
 AlarmController::AlarmController(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    dependents(WaterTower::MaxQuantity),
+    towerState(WaterTower::MaxQuantity)
+{
+    clock.start();
+    rateWindow = Settings::instance()->value("AlarmRateWindow", 60).toInt() * 1000;
+
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        Tower &state = towerState[i];
+        state.known = false;
+        state.online = false;
+        state.offlineSince = 0;
+        state.level = 0;
+
+        WaterTower *tower = WaterTower::instance(i);
+        connect(tower, SIGNAL(waterLevelChanged(int)), this, SLOT(waterLevelChanged(int)));
+        connect(tower, SIGNAL(deviceConnected()), this, SLOT(deviceConnected()));
+        connect(tower, SIGNAL(deviceDisconnected()), this, SLOT(deviceDisconnected()));
+    }
+    connect(NotifyPanel::instance(), SIGNAL(acknowledged(QString)), this, SLOT(notifyAcknowledged(QString)));
+    connect(NotifyPanel::instance(), SIGNAL(snoozed(QString)), this, SLOT(notifySnoozed(QString)));
+
+    timer = new QTimer(this);
+    timer->setInterval(TickInterval);
+    connect(timer, SIGNAL(timeout()), this, SLOT(tick()));
+
+    loadRules();
+}
+
+AlarmController *AlarmController::instance()
+{
+    if (!self)
+        self = new AlarmController(qApp);
+    return self;
+}
+
+/* static */
+QString AlarmController::towerRule(int identity)
+{
+    return QString("tower-%1-high").arg(identity);
+}
+
+/* static, the notification of a rule, stable across boots for the journal */
+QString AlarmController::ruleUuid(const QString &name)
 {
+    return NotifyPanel::instance()->uuid("AlarmRule-" + name);
+}
+
+QStringList AlarmController::rules() const
+{
+    QStringList names;
+    foreach (const Rule &rule, ruleList)
+        names.append(rule.name);
+    return names;
+}
+
+bool AlarmController::isActive(const QString &name) const
+{
+    int index = ruleIndex.value(name, -1);
+    return index >= 0 && ruleList.at(index).active;
+}
+
+bool AlarmController::isPaused(const QString &name) const
+{
+    int index = ruleIndex.value(name, -1);
+    return index >= 0 && ruleList.at(index).paused;
+}
+
+/* paused rules that refer to the tower, its own included */
+QStringList AlarmController::pausedRules(int tower) const
+{
+    QStringList names;
+    foreach (const Rule &rule, ruleList) {
+        if (rule.paused && (rule.towers & (1u << tower)))
+            names.append(rule.name);
+    }
+    return names;
+}
+
+bool AlarmController::isAcknowledged(const QString &name) const
+{
+    int index = ruleIndex.value(name, -1);
+    return index >= 0 && ruleList.at(index).acknowledged;
+}
+
+/* measured in the unit of "second" */
+int AlarmController::snoozeRemaining(const QString &name) const
+{
+    int index = ruleIndex.value(name, -1);
+    if (index < 0)
+        return 0;
+    return qMax(qint64(0), (ruleList.at(index).snoozeUntil - clock.elapsed() + 999) / 1000);
+}
 
+/* static, measured in the unit of "second" */
+int AlarmController::snoozeTime()
+{
+    return Settings::instance()->value("AlarmSnooze", 600).toInt();
+}
+
+/* silent for seconds; raised again afterwards if the condition still holds */
+void AlarmController::snooze(const QString &name, int seconds)
+{
+    int index = ruleIndex.value(name, -1);
+    if (index < 0)
+        return;
+
+    Rule &rule = ruleList[index];
+    qint64 now = clock.elapsed();
+    rule.snoozeUntil = now + qint64(seconds) * 1000;
+    if (rule.active)
+        clear(rule);
+    qDebug() << "Alarm rule" << name << "snoozed for" << seconds << "s";
+    evaluate(index, now);
 }
 
+void AlarmController::pause(const QString &name)
+{
+    int index = ruleIndex.value(name, -1);
+    if (index < 0 || ruleList.at(index).paused)
+        return;
+
+    Rule &rule = ruleList[index];
+    if (rule.active)
+        clear(rule);
+    rule.paused = true;
+    rule.since = -1;
+    Settings::instance()->beginGroup("AlarmRule-" + name);
+    Settings::instance()->setValue("paused", true);
+    Settings::instance()->endGroup();
+    qDebug() << "Alarm rule" << name << "paused";
+    emit pausedChanged(name, true);
+    evaluate(index, clock.elapsed());
+}
+
+void AlarmController::resume(const QString &name)
+{
+    int index = ruleIndex.value(name, -1);
+    if (index < 0 || !ruleList.at(index).paused)
+        return;
+
+    ruleList[index].paused = false;
+    Settings::instance()->beginGroup("AlarmRule-" + name);
+    Settings::instance()->setValue("paused", false);
+    Settings::instance()->endGroup();
+    qDebug() << "Alarm rule" << name << "resumed";
+    emit pausedChanged(name, false);
+    evaluate(index, clock.elapsed());
+}
+
+/* no more reminders, the alarm stays active until it clears */
+void AlarmController::acknowledge(const QString &name)
+{
+    int index = ruleIndex.value(name, -1);
+    if (index < 0 || !ruleList.at(index).active)
+        return;
+
+    ruleList[index].acknowledged = true;
+    evaluate(index, clock.elapsed());
+}
+
+void AlarmController::waterLevelChanged(int centimetre)
+{
+    int identity = towerOf(sender());
+    if (identity < 0)
+        return;
+
+    qint64 now = clock.elapsed();
+    Tower &state = towerState[identity];
+    state.known = true;
+    state.level = centimetre;
+    state.samples.append(qMakePair(now, centimetre));
+    /* keep one sample just outside the window as the anchor of the rate */
+    while (state.samples.count() > 2 && now - state.samples.at(1).first >= rateWindow)
+        state.samples.removeFirst();
+
+    evaluateTower(identity);
+}
+
+void AlarmController::deviceConnected()
+{
+    int identity = towerOf(sender());
+    /* emitted on every reply, only a change is worth a look at the rules */
+    if (identity < 0 || towerState.at(identity).online)
+        return;
+
+    towerState[identity].online = true;
+    evaluateTower(identity);
+}
+
+void AlarmController::deviceDisconnected()
+{
+    int identity = towerOf(sender());
+    if (identity < 0 || !towerState.at(identity).online)
+        return;
+
+    towerState[identity].online = false;
+    towerState[identity].offlineSince = clock.elapsed();
+    evaluateTower(identity);
+}
+
+void AlarmController::notifyAcknowledged(const QString &uuid)
+{
+    for (int i = 0; i < ruleList.count(); i++) {
+        if (ruleList.at(i).uuid == uuid && ruleList.at(i).active) {
+            ruleList[i].acknowledged = true;
+            evaluate(i, clock.elapsed());
+        }
+    }
+}
+
+/* the snooze button of the panel, tower rules go through their tower */
+void AlarmController::notifySnoozed(const QString &uuid)
+{
+    for (int i = 0; i < ruleList.count(); i++) {
+        if (ruleList.at(i).uuid != uuid)
+            continue;
+        if (ruleList.at(i).tower >= 0)
+            WaterTower::instance(ruleList.at(i).tower)->pauseAlarm();
+        else
+            snooze(ruleList.at(i).name, snoozeTime());
+    }
+}
+
+void AlarmController::tick()
+{
+    qint64 now = clock.elapsed();
+    foreach (int index, clockedRules.values())
+        evaluate(index, now);
+}
+
+void AlarmController::loadRules()
+{
+    QStringList groups = Settings::instance()->childGroups();
+
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        Rule rule;
+        rule.name = towerRule(i);
+        rule.tower = i;
+        rule.priority = NotifyPanel::Middle;
+        rule.hold = 0;
+        rule.repeat = 0;
+        rule.paused = false;
+        if (groups.contains("AlarmRule-" + rule.name)) {
+            Settings::instance()->beginGroup("AlarmRule-" + rule.name);
+            rule.hold = Settings::instance()->value("for", 0).toDouble() * 1000;
+            rule.repeat = Settings::instance()->value("repeat", 0).toDouble() * 1000;
+            rule.paused = Settings::instance()->value("paused", false).toBool();
+            Settings::instance()->endGroup();
+        }
+        /* full, and cleared once the level is a sensor below the top again */
+        addRule(rule, QString("level(%1) >= height(%1)").arg(i), QString("level(%1) < height(%1) - step(%1)").arg(i));
+    }
+
+    foreach (const QString &group, groups) {
+        if (!group.startsWith("AlarmRule-"))
+            continue;
+        QString name = group.mid(QString("AlarmRule-").size());
+        if (ruleIndex.contains(name))
+            continue;
+
+        Settings::instance()->beginGroup(group);
+        Rule rule;
+        rule.name = name;
+        rule.tower = -1;
+        rule.text = Settings::instance()->value("message", name).toString();
+        rule.icon = Settings::instance()->value("icon", "").toString();
+        if (!rule.icon.isEmpty() && !rule.icon.startsWith('/'))
+            rule.icon = qApp->applicationDirPath() + "/" + rule.icon;
+        QString priority = Settings::instance()->value("priority", "middle").toString().toLower();
+        rule.priority = priority == "high" ? NotifyPanel::High
+                      : priority == "low" ? NotifyPanel::Low : NotifyPanel::Middle;
+        rule.hold = Settings::instance()->value("for", 0).toDouble() * 1000;
+        rule.repeat = Settings::instance()->value("repeat", 0).toDouble() * 1000;
+        rule.paused = Settings::instance()->value("paused", false).toBool();
+        QString condition = Settings::instance()->value("condition").toString();
+        QString clear = Settings::instance()->value("clear").toString();
+        Settings::instance()->endGroup();
+
+        addRule(rule, condition, clear);
+    }
+}
+
+void AlarmController::addRule(Rule &rule, const QString &condition, const QString &clear)
+{
+    QString error;
+    if (!compile(condition, &rule.condition, &error)) {
+        qDebug() << "Alarm rule" << rule.name << "condition:" << error;
+        return;
+    }
+    if (!clear.isEmpty() && !compile(clear, &rule.clear, &error)) {
+        qDebug() << "Alarm rule" << rule.name << "clear:" << error;
+        return;
+    }
+
+    rule.uuid = ruleUuid(rule.name);
+    rule.towers = 0;
+    rule.clocked = false;
+    Program both = rule.condition + rule.clear;
+    foreach (const Instruction &instruction, both) {
+        if (instruction.tower >= 0)
+            rule.towers |= 1u << instruction.tower;
+        if (instruction.operation == Offline)
+            rule.clocked = true;
+    }
+
+    rule.active = false;
+    rule.acknowledged = false;
+    rule.since = -1;
+    rule.snoozeUntil = 0;
+    rule.lastRaised = 0;
+
+    int index = ruleList.count();
+    ruleList.append(rule);
+    ruleIndex.insert(rule.name, index);
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        if (rule.towers & (1u << i))
+            dependents[i].append(index);
+    }
+
+    /* offline() counts from now for towers that never answer */
+    evaluate(index, clock.elapsed());
+}
+
+void AlarmController::evaluate(int index, qint64 now)
+{
+    Rule &rule = ruleList[index];
+
+    if (!rule.paused) {
+        if (!rule.active) {
+            if (truth(run(rule.condition))) {
+                if (rule.since < 0)
+                    rule.since = now;
+                if (now - rule.since >= rule.hold && now >= rule.snoozeUntil && !raise(rule, now))
+                    rule.since = -1;
+            } else {
+                rule.since = -1;
+            }
+        } else {
+            bool cleared = rule.clear.isEmpty() ? !truth(run(rule.condition)) : truth(run(rule.clear));
+            if (cleared) {
+                clear(rule);
+            } else if (rule.repeat > 0 && !rule.acknowledged && now - rule.lastRaised >= rule.repeat) {
+                rule.lastRaised = now;
+                notify(rule);
+            }
+        }
+    }
+
+    if (needsClock(rule, now))
+        clockedRules.insert(index);
+    else
+        clockedRules.remove(index);
+
+    if (clockedRules.isEmpty())
+        timer->stop();
+    else if (!timer->isActive())
+        timer->start();
+}
+
+void AlarmController::evaluateTower(int tower)
+{
+    qint64 now = clock.elapsed();
+    foreach (int index, dependents.at(tower))
+        evaluate(index, now);
+}
+
+double AlarmController::run(const Program &program) const
+{
+    QVarLengthArray<double, 16> stack;
+    qint64 now = clock.elapsed();
+
+    foreach (const Instruction &instruction, program) {
+        if (instruction.operation >= Add) {
+            double b = stack.last();
+            stack.removeLast();
+            double &a = stack.last();
+
+            switch (instruction.operation) {
+            case Add:
+                a = a + b;
+                break;
+            case Subtract:
+                a = a - b;
+                break;
+            case Multiply:
+                a = a * b;
+                break;
+            case Divide:
+                a = b != 0 ? a / b : NAN;
+                break;
+            case Less:
+                a = a < b;
+                break;
+            case LessEqual:
+                a = a <= b;
+                break;
+            case Greater:
+                a = a > b;
+                break;
+            case GreaterEqual:
+                a = a >= b;
+                break;
+            case Equal:
+                a = a == b;
+                break;
+            case NotEqual:
+                a = a == a && b == b && a != b;
+                break;
+            case And:
+                a = truth(a) && truth(b);
+                break;
+            case Or:
+                a = truth(a) || truth(b);
+                break;
+            default:
+                break;
+            }
+            continue;
+        }
+
+        const Tower *state = instruction.tower >= 0 ? &towerState.at(instruction.tower) : 0;
+        switch (instruction.operation) {
+        case Constant:
+            stack.append(instruction.value);
+            break;
+        case Level:
+            stack.append(state->known ? state->level : NAN);
+            break;
+        case Height:
+            stack.append(WaterTower::instance(instruction.tower)->getHeight());
+            break;
+        case Step:
+            stack.append(WaterTower::instance(instruction.tower)->getLevelStep());
+            break;
+        case Percent: {
+            int height = WaterTower::instance(instruction.tower)->getHeight();
+            stack.append(state->known && height > 0 ? state->level * 100 / height : NAN);
+            break;
+        }
+        case Rate:
+            stack.append(rate(instruction.tower));
+            break;
+        case Offline:
+            stack.append(state->online ? 0 : (now - state->offlineSince) / 1000.0);
+            break;
+        case Online:
+            stack.append(state->online ? 1 : 0);
+            break;
+        case Negate:
+            stack.last() = -stack.last();
+            break;
+        case Not:
+            stack.last() = !truth(stack.last());
+            break;
+        default:
+            break;
+        }
+    }
+
+    return stack.isEmpty() ? 0 : stack.last();
+}
+
+/* centimetres per minute across the window, NaN without two readings */
+double AlarmController::rate(int tower) const
+{
+    const QList<QPair<qint64, int> > &samples = towerState.at(tower).samples;
+    if (samples.count() < 2)
+        return NAN;
+
+    qint64 elapsed = samples.last().first - samples.first().first;
+    if (elapsed <= 0)
+        return NAN;
+    return (samples.last().second - samples.first().second) * 60000.0 / elapsed;
+}
+
+bool AlarmController::needsClock(const Rule &rule, qint64 now) const
+{
+    if (rule.paused)
+        return false;
+
+    if (!rule.active && rule.since >= 0
+            && (now - rule.since < rule.hold || now < rule.snoozeUntil))
+        return true;
+
+    if (rule.active && rule.repeat > 0 && !rule.acknowledged)
+        return true;
+
+    if (rule.clocked) {
+        for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+            if ((rule.towers & (1u << i)) && !towerState.at(i).online)
+                return true;
+        }
+    }
+    return false;
+}
+
+bool AlarmController::raise(Rule &rule, qint64 now)
+{
+    if (rule.tower >= 0) {
+        /* the switch on the tower page arms its built in rule */
+        WaterTower *tower = WaterTower::instance(rule.tower);
+        if (!tower->isAlarmEnabled() || !towerState.at(rule.tower).online)
+            return false;
+    }
+
+    rule.active = true;
+    rule.acknowledged = false;
+    rule.lastRaised = now;
+    qDebug() << "Alarm rule" << rule.name << "raised";
+    notify(rule);
+    emit alarmRaised(rule.name);
+    return true;
+}
+
+void AlarmController::notify(Rule &rule)
+{
+    if (rule.tower >= 0)
+        WaterTower::instance(rule.tower)->raiseAlarm();
+    else
+        NotifyPanel::instance()->addNotify(rule.uuid, rule.priority, rule.text, rule.icon);
+}
+
+void AlarmController::clear(Rule &rule)
+{
+    rule.active = false;
+    rule.acknowledged = false;
+    if (rule.tower >= 0)
+        WaterTower::instance(rule.tower)->clearAlarm();
+    qDebug() << "Alarm rule" << rule.name << "cleared";
+    emit alarmCleared(rule.name);
+}
+
+int AlarmController::towerOf(QObject *object) const
+{
+    WaterTower *tower = qobject_cast<WaterTower *>(object);
+    return tower ? tower->getIdentity() : -1;
+}
+
+/* static */
+bool AlarmController::compile(const QString &text, Program *program, QString *error)
+{
+    program->clear();
+    RuleCompiler compiler(text, program);
+    return compiler.compile(error);
+}
@@ -2,16 +2,184 @@
 #define ALARMCONTROLLER_H
 
 #include <QObject>
+#include <QVector>
+#include <QList>
+#include <QSet>
+#include <QHash>
+#include <QElapsedTimer>
 
+#include "notifypanel.h"
+
+class QTimer;
+
+/*
+ * Rule based alarms over the readings of all water towers.
+ *
+ * Every [AlarmRule-<name>] settings group is a rule:
+ *
+ *   condition=level(0) > 300 and rate(0) > 20    raise while true
+ *   clear=level(0) < 250       clear once true, by default when condition is false
+ *   for=30                     seconds the condition has to hold first
+ *   repeat=600                 seconds between reminders until acknowledged
+ *   priority=high              low, middle or high
+ *   message=Ground floor overflowing
+ *   icon=images/watertower-0.png
+ *   paused=false
+ *
+ * Expressions know numbers, + - * /, comparisons, and, or, not and
+ * parentheses over level(n), height(n) and step(n), the spacing of the
+ * level sensors, in centimetres, percent(n), rate(n) in centimetres per
+ * minute over AlarmRateWindow seconds, offline(n) in seconds and online(n).
+ * A tower without a reading yet compares false. The high water level alarm
+ * of every tower is a built in rule of the same kind.
+ *
+ * A rule is snoozed from the notification panel or, like pause, resume and
+ * acknowledge, through HttpServer. A pause is kept in the settings; the
+ * page of every tower a paused rule refers to shows it and resumes it.
+ *
+ * Rules are compiled to postfix programs once. A reading only runs the
+ * rules that refer to that tower; a one second tick only runs while a rule
+ * waits for its hold time, a snooze, a reminder or an offline tower.
+ */
 class AlarmController : public QObject
 {
     Q_OBJECT
+
 public:
-    explicit AlarmController(QObject *parent = 0);
+    static AlarmController *instance();
+
+    static QString towerRule(int identity);
+    static QString ruleUuid(const QString &name);
+
+    QStringList rules() const;
+    bool contains(const QString &name) const
+    {
+        return ruleIndex.contains(name);
+    }
+    bool isActive(const QString &name) const;
+    bool isPaused(const QString &name) const;
+    QStringList pausedRules(int tower) const;
+    bool isAcknowledged(const QString &name) const;
+    int snoozeRemaining(const QString &name) const;
+
+    static int snoozeTime();
 
 signals:
+    void alarmRaised(const QString &name);
+    void alarmCleared(const QString &name);
+    void pausedChanged(const QString &name, bool paused);
 
 public slots:
+    void snooze(const QString &name, int seconds);
+    void pause(const QString &name);
+    void resume(const QString &name);
+    void acknowledge(const QString &name);
+
+private slots:
+    void waterLevelChanged(int centimetre);
+    void deviceConnected();
+    void deviceDisconnected();
+    void notifyAcknowledged(const QString &uuid);
+    void notifySnoozed(const QString &uuid);
+    void tick();
+
+private:
+    /* postfix, everything from Add on pops two operands */
+    enum Operation {
+        Constant,
+        Level,
+        Height,
+        Step,
+        Percent,
+        Rate,
+        Offline,
+        Online,
+        Negate,
+        Not,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+        And,
+        Or
+    };
+
+    struct Instruction {
+        Operation operation;
+        int tower;
+        double value;
+    };
+
+    typedef QVector<Instruction> Program;
+
+    struct Rule {
+        QString name;
+        QString uuid;
+        QString text;
+        QString icon;
+        NotifyPanel::Priority priority;
+        int tower;              /*  built in rule of this tower, -1 for configured ones  */
+
+        Program condition;
+        Program clear;          /*  empty to clear when condition is false  */
+        quint32 towers;         /*  referred to, one bit per tower  */
+        bool clocked;           /*  refers to offline() and changes with time alone  */
+        qint64 hold;            /*  measured in the unit of "millisecond"  */
+        qint64 repeat;
+
+        bool active;
+        bool acknowledged;
+        bool paused;
+        qint64 since;           /*  condition true since, -1 while false  */
+        qint64 snoozeUntil;
+        qint64 lastRaised;
+    };
+
+    struct Tower {
+        bool known;
+        bool online;
+        qint64 offlineSince;
+        double level;
+        QList<QPair<qint64, int> > samples;   /*  time and level within the rate window  */
+    };
+
+    friend class RuleCompiler;
+    friend class AlarmRulesTest;
+
+    explicit AlarmController(QObject *parent = 0);
+    Q_DISABLE_COPY(AlarmController)
+    void loadRules();
+    void addRule(Rule &rule, const QString &condition, const QString &clear);
+    void evaluate(int index, qint64 now);
+    void evaluateTower(int tower);
+    double run(const Program &program) const;
+    double rate(int tower) const;
+    bool needsClock(const Rule &rule, qint64 now) const;
+    bool raise(Rule &rule, qint64 now);
+    void notify(Rule &rule);
+    void clear(Rule &rule);
+    int towerOf(QObject *object) const;
+
+    static bool compile(const QString &text, Program *program, QString *error);
+
+private:
+    static AlarmController *self;
+
+    QVector<Rule> ruleList;
+    QHash<QString, int> ruleIndex;
+    QVector<QList<int> > dependents;    /*  rules to run per tower  */
+    QSet<int> clockedRules;             /*  rules the tick runs  */
+
+    QVector<Tower> towerState;
+    QElapsedTimer clock;
+    QTimer *timer;
+    qint64 rateWindow;      /*  measured in the unit of "millisecond"  */
 };
 
 #endif // ALARMCONTROLLER_H
@@ -0,0 +1,309 @@
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <QApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QTimer>
+#include <QDebug>
+
+#include "settings.h"
+#include "alarmjournal.h"
+
+AlarmJournal *AlarmJournal::self = 0;
+bool AlarmJournal::readOnly = false;
+
+const qint64 AlarmJournal::MaxSize = 1024 * 1024;
+
+static const int SyncDelay = 2000;
+
+static bool raisedEarlier(const AlarmJournal::Record &a, const AlarmJournal::Record &b)
+{
+    return a.time < b.time;
+}
+
+AlarmJournal::AlarmJournal(QObject *parent) :
+    QObject(parent)
+{
+    file.setFileName(Settings::dataDirectory() + "/alarms.journal");
+
+    qint64 validSize = 0;
+    QList<Record> records = read(file.fileName(), &validSize);
+    foreach (const Record &record, records)
+        apply(record);
+
+    if (readOnly) {
+        if (!file.open(QIODevice::ReadOnly))
+            qDebug() << "Alarm journal can not be read" << file.fileName();
+    } else if (!file.open(QIODevice::ReadWrite)) {
+        qDebug() << "Alarm journal can not be opened" << file.fileName();
+    } else {
+        if (file.size() != validSize) {
+            qDebug() << "Alarm journal torn record dropped," << file.size() - validSize << "bytes";
+            file.resize(validSize);
+        }
+        file.seek(validSize);
+    }
+
+    syncTimer = new QTimer(this);
+    syncTimer->setSingleShot(true);
+    connect(syncTimer, SIGNAL(timeout()), this, SLOT(sync()));
+}
+
+AlarmJournal::~AlarmJournal()
+{
+    sync();
+}
+
+AlarmJournal *AlarmJournal::instance()
+{
+    if (!self)
+        self = new AlarmJournal(qApp);
+    return self;
+}
+
+/* static, for tools reading the journal; must be called before the first instance() call */
+void AlarmJournal::setReadOnly(bool readOnly)
+{
+    AlarmJournal::readOnly = readOnly;
+}
+
+void AlarmJournal::raise(const QString &uuid, int priority, const QString &text, const QString &icon)
+{
+    Record record;
+    record.type = Raise;
+    record.priority = priority;
+    record.time = QDateTime::currentMSecsSinceEpoch();
+    record.uuid = uuid;
+    record.text = text;
+    record.icon = icon;
+    append(record);
+}
+
+void AlarmJournal::update(const QString &uuid, int priority, const QString &text, const QString &icon)
+{
+    Record record;
+    record.type = Update;
+    record.priority = priority;
+    record.time = QDateTime::currentMSecsSinceEpoch();
+    record.uuid = uuid;
+    record.text = text;
+    record.icon = icon;
+    append(record);
+}
+
+void AlarmJournal::acknowledge(const QString &uuid)
+{
+    Record record;
+    record.type = Acknowledge;
+    record.priority = 0;
+    record.time = QDateTime::currentMSecsSinceEpoch();
+    record.uuid = uuid;
+    append(record);
+}
+
+void AlarmJournal::drop(const QString &uuid)
+{
+    Record record;
+    record.type = Drop;
+    record.priority = 0;
+    record.time = QDateTime::currentMSecsSinceEpoch();
+    record.uuid = uuid;
+    append(record);
+}
+
+QList<AlarmJournal::Record> AlarmJournal::outstanding() const
+{
+    QList<Record> list = pending.values();
+    /* oldest first, the order they were raised in */
+    std::sort(list.begin(), list.end(), raisedEarlier);
+    return list;
+}
+
+QList<AlarmJournal::Record> AlarmJournal::query(qint64 from, qint64 to, const QString &uuid) const
+{
+    QList<Record> result;
+    QStringList fileNames;
+    fileNames << file.fileName() + ".1" << file.fileName();
+
+    foreach (const QString &fileName, fileNames) {
+        foreach (const Record &record, read(fileName)) {
+            if (record.time < from || record.time >= to)
+                continue;
+            if (!uuid.isEmpty() && record.uuid != uuid)
+                continue;
+            result.append(record);
+        }
+    }
+    return result;
+}
+
+AlarmJournal::Statistics AlarmJournal::statistics(qint64 from, qint64 to) const
+{
+    Statistics statistics;
+    statistics.raised = 0;
+    statistics.acknowledged = 0;
+    statistics.mean = 0;
+    statistics.median = 0;
+    statistics.percentile95 = 0;
+    statistics.maximum = 0;
+
+    QHash<QString, qint64> raisedAt;
+    QList<qint64> responses;
+    foreach (const Record &record, query(from, to)) {
+        switch (record.type) {
+        case Raise:
+            /* outstanding alarms are raised again at the top of a rotated journal */
+            if (!raisedAt.contains(record.uuid)) {
+                raisedAt.insert(record.uuid, record.time);
+                statistics.raised++;
+            }
+            break;
+        case Acknowledge:
+            if (raisedAt.contains(record.uuid)) {
+                responses.append(record.time - raisedAt.take(record.uuid));
+                statistics.acknowledged++;
+            }
+            break;
+        case Drop:
+            raisedAt.remove(record.uuid);
+            break;
+        default:
+            break;
+        }
+    }
+    statistics.outstanding = raisedAt.count();
+
+    if (!responses.isEmpty()) {
+        std::sort(responses.begin(), responses.end());
+        qint64 total = 0;
+        foreach (qint64 response, responses)
+            total += response;
+        statistics.mean = total / responses.count();
+        statistics.median = responses.at(responses.count() / 2);
+        statistics.percentile95 = responses.at((responses.count() - 1) * 95 / 100);
+        statistics.maximum = responses.last();
+    }
+
+    return statistics;
+}
+
+void AlarmJournal::sync()
+{
+    syncTimer->stop();
+    if (file.isWritable()) {
+        file.flush();
+        ::fdatasync(file.handle());
+    }
+}
+
+void AlarmJournal::append(const Record &record)
+{
+    apply(record);
+
+    if (!file.isWritable())
+        return;
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << quint8(record.type) << quint8(record.priority) << record.time
+        << record.uuid.toLatin1() << record.text.toUtf8() << record.icon.toUtf8();
+
+    QByteArray frame;
+    QDataStream header(&frame, QIODevice::WriteOnly);
+    header.setByteOrder(QDataStream::LittleEndian);
+    header << quint16(payload.size());
+    frame.append(payload);
+    file.write(frame);
+    file.flush();
+
+    if (file.pos() > MaxSize)
+        rotate();
+    else if (!syncTimer->isActive())
+        syncTimer->start(SyncDelay);
+}
+
+void AlarmJournal::apply(const Record &record)
+{
+    switch (record.type) {
+    case Raise:
+        pending.insert(record.uuid, record);
+        break;
+    case Update:
+        if (pending.contains(record.uuid)) {
+            Record &raised = pending[record.uuid];
+            raised.priority = record.priority;
+            raised.text = record.text;
+            raised.icon = record.icon;
+        } else {
+            Record raised = record;
+            raised.type = Raise;
+            pending.insert(record.uuid, raised);
+        }
+        break;
+    case Acknowledge:
+    case Drop:
+        pending.remove(record.uuid);
+        break;
+    }
+}
+
+void AlarmJournal::rotate()
+{
+    sync();
+    file.close();
+
+    QString previous = file.fileName() + ".1";
+    QFile::remove(previous);
+    QFile::rename(file.fileName(), previous);
+
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        qDebug() << "Alarm journal can not be opened" << file.fileName();
+        return;
+    }
+
+    /* carry the outstanding alarms over, replay only needs the current file */
+    foreach (const Record &record, outstanding())
+        append(record);
+    sync();
+}
+
+/* static */
+QList<AlarmJournal::Record> AlarmJournal::read(const QString &fileName, qint64 *validSize)
+{
+    QList<Record> records;
+    qint64 offset = 0;
+
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly)) {
+        QByteArray content = file.readAll();
+        while (offset + 2 <= content.size()) {
+            quint16 length = quint8(content.at(offset)) | (quint8(content.at(offset + 1)) << 8);
+            if (offset + 2 + length > content.size())
+                break;
+
+            QDataStream in(content.mid(offset + 2, length));
+            in.setByteOrder(QDataStream::LittleEndian);
+            quint8 type, priority;
+            QByteArray uuid, text, icon;
+            Record record;
+            in >> type >> priority >> record.time >> uuid >> text >> icon;
+            if (in.status() != QDataStream::Ok || type < Raise || type > Drop)
+                break;
+
+            record.type = Type(type);
+            record.priority = priority;
+            record.uuid = QString::fromLatin1(uuid);
+            record.text = QString::fromUtf8(text);
+            record.icon = QString::fromUtf8(icon);
+            records.append(record);
+            offset += 2 + length;
+        }
+    }
+
+    if (validSize)
+        *validSize = offset;
+    return records;
+}
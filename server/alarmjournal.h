@@ -0,0 +1,87 @@
+#ifndef ALARMJOURNAL_H
+#define ALARMJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QList>
+
+class QTimer;
+
+/*
+ * Append-only binary journal of alarm notifications.
+ *
+ * Each record is a 16 bit length followed by its payload, so a record torn
+ * by a power cut is detected and cut off when the journal is reopened.
+ * Every append is flushed to the page cache at once, so it survives a crash
+ * of the process; fdatasync is batched by a short timer. The journal is
+ * rotated to alarms.journal.1 once it grows too big. Opened read-only it
+ * answers queries and leaves the file alone, torn tail included.
+ */
+class AlarmJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Type {
+        Raise = 1,
+        Update,
+        Acknowledge,
+        Drop
+    };
+
+    struct Record {
+        Type type;
+        int priority;
+        qint64 time;        /*  milliseconds since epoch  */
+        QString uuid;
+        QString text;
+        QString icon;
+    };
+
+    struct Statistics {
+        int raised;
+        int acknowledged;
+        int outstanding;
+        qint64 mean;        /*  raise to acknowledge, measured in the unit of "millisecond"  */
+        qint64 median;
+        qint64 percentile95;
+        qint64 maximum;
+    };
+
+    static AlarmJournal *instance();
+    static void setReadOnly(bool readOnly);
+
+    void raise(const QString &uuid, int priority, const QString &text, const QString &icon);
+    void update(const QString &uuid, int priority, const QString &text, const QString &icon);
+    void acknowledge(const QString &uuid);
+    void drop(const QString &uuid);
+
+    QList<Record> outstanding() const;
+    QList<Record> query(qint64 from, qint64 to, const QString &uuid = QString()) const;
+    Statistics statistics(qint64 from, qint64 to) const;
+
+public slots:
+    void sync();
+
+private:
+    explicit AlarmJournal(QObject *parent = 0);
+    ~AlarmJournal();
+    Q_DISABLE_COPY(AlarmJournal)
+    void append(const Record &record);
+    void apply(const Record &record);
+    void rotate();
+    static QList<Record> read(const QString &fileName, qint64 *validSize = 0);
+
+private:
+    static AlarmJournal *self;
+    static bool readOnly;
+
+    QFile file;
+    QTimer *syncTimer;
+    QHash<QString, Record> pending;    /*  raised and not yet acknowledged, by uuid  */
+
+    static const qint64 MaxSize;
+};
+
+#endif // ALARMJOURNAL_H
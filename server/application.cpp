@@ -0,0 +1,21 @@
+#include <QThread>
+
+#include "eventloopmonitor.h"
+#include "application.h"
+
+Application::Application(int &argc, char **argv) :
+    QApplication(argc, argv)
+{
+}
+
+bool Application::notify(QObject *receiver, QEvent *event)
+{
+    if (!EventLoopMonitor::exists() || QThread::currentThread() != thread())
+        return QApplication::notify(receiver, event);
+
+    EventLoopMonitor *monitor = EventLoopMonitor::instance();
+    monitor->dispatchStarted(receiver, event);
+    bool result = QApplication::notify(receiver, event);
+    monitor->dispatchFinished();
+    return result;
+}
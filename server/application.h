@@ -0,0 +1,17 @@
+#ifndef APPLICATION_H
+#define APPLICATION_H
+
+#include <QApplication>
+
+/* Reports GUI thread dispatches to the EventLoopMonitor */
+class Application : public QApplication
+{
+    Q_OBJECT
+
+public:
+    Application(int &argc, char **argv);
+
+    virtual bool notify(QObject *receiver, QEvent *event);
+};
+
+#endif // APPLICATION_H
@@ -0,0 +1,157 @@
+#include <QApplication>
+#include <QAudioBuffer>
+#include <QTimer>
+#include <QDebug>
+
+#include "audioclips.h"
+
+AudioClips *AudioClips::self = 0;
+
+static const int MaxAttempts = 2;
+
+AudioClips::AudioClips(QObject *parent) :
+    QObject(parent)
+{
+    /* mono 16 bit at the rate of the smaller clips keeps the buffers small */
+    QAudioFormat format;
+    format.setSampleRate(22050);
+    format.setChannelCount(1);
+    format.setSampleSize(16);
+    format.setSampleType(QAudioFormat::SignedInt);
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setCodec("audio/pcm");
+
+    decoder = new QAudioDecoder(this);
+    decoder->setAudioFormat(format);
+    connect(decoder, SIGNAL(bufferReady()), this, SLOT(bufferReady()));
+    connect(decoder, SIGNAL(finished()), this, SLOT(finished()));
+    connect(decoder, SIGNAL(error(QAudioDecoder::Error)), this, SLOT(error(QAudioDecoder::Error)));
+
+    names << "high" << "middle" << "low" << "volume";
+    foreach (const QString &name, names) {
+        clips[name].ready = false;
+        clips[name].failed = false;
+        clips[name].attempts = 0;
+    }
+    pending = names;
+
+    decodeNext();
+}
+
+AudioClips *AudioClips::instance()
+{
+    if (!self)
+        self = new AudioClips();
+    return self;
+}
+
+bool AudioClips::isReady(const QString &name) const
+{
+    return clips.contains(name) && clips[name].ready;
+}
+
+bool AudioClips::hasFailed(const QString &name) const
+{
+    return clips.contains(name) && clips[name].failed;
+}
+
+bool AudioClips::isDecoding() const
+{
+    return !decoding.isEmpty() || !pending.isEmpty();
+}
+
+/* the most urgent clip decoded, for one that failed */
+QString AudioClips::fallback() const
+{
+    foreach (const QString &name, names) {
+        if (clips[name].ready)
+            return name;
+    }
+    return QString();
+}
+
+QByteArray AudioClips::pcm(const QString &name) const
+{
+    return clips.value(name).pcm;
+}
+
+QAudioFormat AudioClips::format(const QString &name) const
+{
+    return clips.value(name).format;
+}
+
+void AudioClips::bufferReady()
+{
+    QAudioBuffer buffer = decoder->read();
+    if (!buffer.isValid() || decoding.isEmpty())
+        return;
+
+    Clip &clip = clips[decoding];
+    clip.format = buffer.format();
+    clip.pcm.append(buffer.constData<char>(), buffer.byteCount());
+}
+
+void AudioClips::finished()
+{
+    /* left over from a decode already given up by error() */
+    if (decoding.isEmpty())
+        return;
+
+    QString name = decoding;
+    Clip &clip = clips[name];
+    clip.pcm.squeeze();
+    clip.ready = !clip.pcm.isEmpty();
+    qDebug() << "Audio clip" << name << "decoded," << clip.pcm.size() << "bytes";
+
+    bool decoded = clip.ready;
+    decoding.clear();
+    if (!decoded)
+        fail(name);
+    decodeNext();
+    if (decoded)
+        emit ready(name);
+}
+
+void AudioClips::error(QAudioDecoder::Error error)
+{
+    if (decoding.isEmpty())
+        return;
+
+    qDebug() << "Audio clip" << decoding << "can not be decoded" << error << decoder->errorString();
+    QString name = decoding;
+    clips[name].pcm.clear();
+    decoder->stop();
+
+    /*
+     * The backend may still deliver a finished() for this decode, it finds
+     * nothing being decoded and is dropped instead of ending the next clip.
+     */
+    decoding.clear();
+    QTimer::singleShot(0, this, SLOT(decodeNext()));
+    fail(name);
+}
+
+/* tried again after the others, reported once out of attempts */
+void AudioClips::fail(const QString &name)
+{
+    Clip &clip = clips[name];
+    if (++clip.attempts < MaxAttempts) {
+        pending.append(name);
+        return;
+    }
+
+    clip.failed = true;
+    emit failed(name);
+}
+
+void AudioClips::decodeNext()
+{
+    decoder->stop();
+    decoding.clear();
+    if (pending.isEmpty())
+        return;
+
+    decoding = pending.takeFirst();
+    decoder->setSourceFilename(QString("%1/audios/%2.mp3").arg(qApp->applicationDirPath()).arg(decoding));
+    decoder->start();
+}
@@ -0,0 +1,64 @@
+#ifndef AUDIOCLIPS_H
+#define AUDIOCLIPS_H
+
+#include <QObject>
+#include <QAudioFormat>
+#include <QAudioDecoder>
+#include <QStringList>
+#include <QMap>
+
+/*
+ * The sounds under audios/ decoded once into PCM.
+ *
+ * Decoding runs one clip at a time in the background right after startup,
+ * players only ever copy raw samples afterwards. A clip that fails to decode
+ * is tried once more after the others, then reported as failed.
+ */
+class AudioClips : public QObject
+{
+    Q_OBJECT
+
+public:
+    static AudioClips *instance();
+
+    bool isReady(const QString &name) const;
+    bool hasFailed(const QString &name) const;
+    bool isDecoding() const;
+    QString fallback() const;
+    QByteArray pcm(const QString &name) const;
+    QAudioFormat format(const QString &name) const;
+
+signals:
+    void ready(const QString &name);
+    void failed(const QString &name);
+
+private slots:
+    void bufferReady();
+    void finished();
+    void error(QAudioDecoder::Error error);
+    void decodeNext();
+
+private:
+    explicit AudioClips(QObject *parent = 0);
+    Q_DISABLE_COPY(AudioClips)
+    void fail(const QString &name);
+
+private:
+    static AudioClips *self;
+
+    struct Clip {
+        QAudioFormat format;
+        QByteArray pcm;
+        bool ready;
+        bool failed;
+        int attempts;
+    };
+    QMap<QString, Clip> clips;
+    QStringList names;      /*  most urgent first, the order of fallbacks  */
+
+    QStringList pending;
+    QString decoding;
+    QAudioDecoder *decoder;
+};
+
+#endif // AUDIOCLIPS_H
@@ -0,0 +1,202 @@
+#include <string.h>
+
+#include <QThread>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QAudioOutput>
+#include <QAudioDeviceInfo>
+#include <QtEndian>
+#include <QDebug>
+
+#include "settings.h"
+#include "audiostream.h"
+
+AudioStream *AudioStream::self = 0;
+QAtomicInt AudioStream::held;
+
+/* short, the jitter buffer already absorbs the network */
+static const int OutputBuffer = 30000;      /*  measured in the unit of "microsecond"  */
+static const int IdleTimeout = 2000;        /*  measured in the unit of "millisecond"  */
+
+/* hands the audio output one frame of the jitter buffer after the other */
+class StreamDevice : public QIODevice
+{
+public:
+    StreamDevice(JitterBuffer *buffer, QObject *parent = 0) :
+        QIODevice(parent),
+        buffer(buffer),
+        frame(JitterBuffer::FrameBytes, 0),
+        offset(JitterBuffer::FrameBytes)
+    {
+    }
+
+    bool isSequential() const
+    {
+        return true;
+    }
+
+    /* never runs dry, the jitter buffer conceals or plays silence */
+    qint64 bytesAvailable() const
+    {
+        return JitterBuffer::FrameBytes * JitterBuffer::MaxDepth + QIODevice::bytesAvailable();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize)
+    {
+        qint64 total = 0;
+        while (total < maxSize) {
+            if (offset == JitterBuffer::FrameBytes) {
+                buffer->pull(frame.data());
+                offset = 0;
+            }
+            qint64 chunk = qMin(maxSize - total, qint64(JitterBuffer::FrameBytes - offset));
+            memcpy(data + total, frame.constData() + offset, chunk);
+            offset += chunk;
+            total += chunk;
+        }
+        return total;
+    }
+
+    qint64 writeData(const char *data, qint64 maxSize)
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+private:
+    JitterBuffer *buffer;
+    QByteArray frame;
+    int offset;             /*  already handed out of frame  */
+};
+
+AudioStream::AudioStream(QObject *parent) :
+    QObject(parent),
+    socket(0),
+    idleTimer(0),
+    output(0),
+    device(0)
+{
+    /* read here, Settings belongs to the GUI thread */
+    address = QHostAddress(Settings::instance()->value("AudioStreamAddress", "0.0.0.0").toString());
+    port = Settings::instance()->value("AudioStreamPort", 9107).toInt();
+
+    thread = new QThread();
+    moveToThread(thread);
+    connect(thread, SIGNAL(started()), this, SLOT(start()));
+    thread->start(QThread::HighPriority);
+}
+
+AudioStream::~AudioStream()
+{
+    thread->quit();
+    thread->wait();
+    delete thread;
+}
+
+AudioStream *AudioStream::instance()
+{
+    if (!self)
+        self = new AudioStream();
+    return self;
+}
+
+/*
+ * static, from the GUI thread. Returns with the stream output closed, on a
+ * device that opens only once it may not be open twice at all.
+ */
+void AudioStream::holdOutput(bool hold)
+{
+    if (!hold) {
+        held.deref();
+        return;
+    }
+    if (held.fetchAndAddOrdered(1) == 0 && self)
+        QMetaObject::invokeMethod(self, "closeOutput", Qt::BlockingQueuedConnection);
+}
+
+int AudioStream::latency() const
+{
+    const JitterBuffer::Statistics &stats = buffer.statistics();
+    return (stats.depth.load() * JitterBuffer::FrameDuration + OutputBuffer) / 1000;
+}
+
+/* on the stream thread from here on */
+void AudioStream::start()
+{
+    if (port <= 0)
+        return;
+
+    clock.start();
+    datagram.reserve(HeaderSize + JitterBuffer::FrameBytes);
+
+    device = new StreamDevice(&buffer, this);
+    device->open(QIODevice::ReadOnly);
+
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(IdleTimeout);
+    connect(idleTimer, SIGNAL(timeout()), this, SLOT(idle()));
+
+    socket = new QUdpSocket(this);
+    connect(socket, SIGNAL(readyRead()), this, SLOT(readPendingDatagrams()));
+    if (!socket->bind(address, port))
+        qDebug() << "Audio stream can not listen on" << address.toString() << port << socket->errorString();
+}
+
+void AudioStream::readPendingDatagrams()
+{
+    while (socket->hasPendingDatagrams()) {
+        datagram.resize(socket->pendingDatagramSize());
+        socket->readDatagram(datagram.data(), datagram.size());
+        if (datagram.size() != HeaderSize + JitterBuffer::FrameBytes || held.load())
+            continue;
+
+        const uchar *header = reinterpret_cast<const uchar *>(datagram.constData());
+        buffer.push(qFromLittleEndian<quint16>(header), qFromLittleEndian<quint32>(header + 2),
+                    datagram.constData() + HeaderSize, clock.nsecsElapsed() / 1000);
+
+        if (!output)
+            openOutput();
+        idleTimer->start();
+    }
+}
+
+void AudioStream::idle()
+{
+    qDebug() << "Audio stream stopped";
+    closeOutput();
+}
+
+void AudioStream::openOutput()
+{
+    QAudioFormat format;
+    format.setSampleRate(JitterBuffer::SampleRate);
+    format.setChannelCount(1);
+    format.setSampleSize(16);
+    format.setCodec("audio/pcm");
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setSampleType(QAudioFormat::SignedInt);
+
+    QAudioDeviceInfo info = QAudioDeviceInfo::defaultOutputDevice();
+    if (!info.isFormatSupported(format))
+        qDebug() << "Audio stream format not supported by" << info.deviceName();
+
+    output = new QAudioOutput(info, format, this);
+    output->setBufferSize(format.bytesForDuration(OutputBuffer));
+    output->start(device);
+    streaming.store(1);
+    qDebug() << "Audio stream started";
+}
+
+void AudioStream::closeOutput()
+{
+    if (output) {
+        output->stop();
+        delete output;
+        output = 0;
+    }
+    buffer.reset();
+    streaming.store(0);
+}
@@ -0,0 +1,83 @@
+#ifndef AUDIOSTREAM_H
+#define AUDIOSTREAM_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QAtomicInt>
+
+#include "jitterbuffer.h"
+
+class QThread;
+class QTimer;
+class QUdpSocket;
+class QAudioOutput;
+class StreamDevice;
+
+/*
+ * One way audio from a baby-care node.
+ *
+ * A datagram holds a 16 bit sequence number and a 32 bit timestamp in
+ * samples, both little endian, followed by one JitterBuffer frame. The
+ * socket, the jitter buffer and the QAudioOutput pulling from it all live on
+ * a thread of their own, so the sound card never waits for the GUI thread.
+ * The output is only opened while a stream comes in, and never while a
+ * PcmPlayer holds the device: an alarm clip takes priority, the stream is
+ * closed for it and frames arriving meanwhile are dropped. AudioStreamPort
+ * (9107, 0 disables) and AudioStreamAddress select where to listen.
+ */
+class AudioStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int HeaderSize = 6;
+
+    static AudioStream *instance();
+    static void holdOutput(bool hold);
+
+    const JitterBuffer::Statistics &statistics() const
+    {
+        return buffer.statistics();
+    }
+
+    bool isStreaming() const
+    {
+        return streaming.load();
+    }
+
+    /* buffered plus the output buffer, measured in the unit of "millisecond" */
+    int latency() const;
+
+private slots:
+    void start();
+    void readPendingDatagrams();
+    void idle();
+    void closeOutput();
+
+private:
+    explicit AudioStream(QObject *parent = 0);
+    ~AudioStream();
+    Q_DISABLE_COPY(AudioStream)
+    void openOutput();
+
+private:
+    static AudioStream *self;
+    static QAtomicInt held;     /*  PcmPlayers holding the audio device  */
+
+    QThread *thread;
+    QHostAddress address;
+    int port;
+
+    QUdpSocket *socket;
+    QTimer *idleTimer;
+    QAudioOutput *output;
+    StreamDevice *device;
+    QElapsedTimer clock;
+    QByteArray datagram;
+
+    JitterBuffer buffer;
+    QAtomicInt streaming;
+};
+
+#endif // AUDIOSTREAM_H
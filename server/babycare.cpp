@@ -1,8 +1,14 @@
 #include <QApplication>
-#include <QGraphicsPixmapItem>
 #include <QResizeEvent>
+#include <QGraphicsSimpleTextItem>
+#include <QTimer>
 #include <QDebug>
 
+#include "audiostream.h"
+#include "floorplanitem.h"
+#include "sensormarker.h"
+#include "watertower.h"
+#include "watertowerwidget.h"
 #include "babycare.h"
 
 
@@ -10,18 +16,90 @@ BabyCare::BabyCare(QWidget *parent) :
     QGraphicsView(parent)
 {
     setSizeAdjustPolicy(QAbstractScrollArea::AdjustIgnored);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 
     sense = new QGraphicsScene(this);
+    /* markers never move, a BSP index keeps hit-tests and exposes cheap */
+    sense->setItemIndexMethod(QGraphicsScene::BspTreeIndex);
     setScene(sense);
 
-    map = QPixmap(qApp->applicationDirPath() + "/images/home.png");
-    mapItem = sense->addPixmap(QPixmap(1, 1));
-    sense->addText("hello world");
+    mapItem = new FloorPlanItem(qApp->applicationDirPath() + "/images/home.png");
+    mapItem->setZValue(-1);
+    sense->addItem(mapItem);
+    sense->setSceneRect(mapItem->boundingRect());
+
+    createMarkers();
+
+    /* kept at its size however the map is scaled */
+    streamItem = new QGraphicsSimpleTextItem();
+    streamItem->setFlag(QGraphicsItem::ItemIgnoresTransformations);
+    streamItem->setBrush(Qt::darkGreen);
+    streamItem->setPos(sense->sceneRect().topLeft());
+    streamItem->setVisible(false);
+    sense->addItem(streamItem);
+
+    /* only polled while the page is shown, the stream itself runs regardless */
+    streamTimer = new QTimer(this);
+    connect(streamTimer, SIGNAL(timeout()), this, SLOT(updateStream()));
+}
+
+void BabyCare::sensorEnabled(int identity, bool enabled)
+{
+    SensorMarker *marker = markers.value(identity);
+    if (marker)
+        marker->setVisible(enabled);
 }
 
 void BabyCare::resizeEvent(QResizeEvent *event)
 {
-    setSceneRect(QRect(QPoint(0, 0), event->size()));
-    mapItem->setPixmap(map.scaled(event->size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    /* only the view transform changes, tiles are picked at paint time */
+    if (!mapItem->isNull())
+        fitInView(mapItem, Qt::IgnoreAspectRatio);
     QGraphicsView::resizeEvent(event);
 }
+
+void BabyCare::showEvent(QShowEvent *event)
+{
+    updateStream();
+    streamTimer->start(1000);
+    QGraphicsView::showEvent(event);
+}
+
+void BabyCare::hideEvent(QHideEvent *event)
+{
+    streamTimer->stop();
+    QGraphicsView::hideEvent(event);
+}
+
+void BabyCare::updateStream()
+{
+    AudioStream *stream = AudioStream::instance();
+    streamItem->setVisible(stream->isStreaming());
+    if (stream->isStreaming())
+        streamItem->setText(tr("Listening, %1 ms delay").arg(stream->latency()));
+}
+
+void BabyCare::createMarkers()
+{
+    QRectF area = sense->sceneRect();
+
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        WaterTower *waterTower = WaterTower::instance(i);
+        WaterTowerWidget *widget = WaterTowerWidget::instance(i);
+
+        SensorMarker *marker = new SensorMarker(waterTower, widget->readableName(i));
+        QPointF position = waterTower->getMapPosition();
+        if (!area.contains(position)) {
+            /* not placed yet, line them up across the middle of the map */
+            position = QPointF(area.left() + area.width() * (i + 1) / (WaterTower::MaxQuantity + 1),
+                               area.center().y());
+        }
+        marker->setPos(position);
+        marker->setVisible(waterTower->isEnabled());
+        sense->addItem(marker);
+        markers.insert(i, marker);
+
+        connect(widget, SIGNAL(layoutChanged(int,bool)), this, SLOT(sensorEnabled(int,bool)));
+    }
+}
@@ -2,6 +2,12 @@
 #define BABYCARE_H
 
 #include <QGraphicsView>
+#include <QMap>
+
+class QGraphicsSimpleTextItem;
+class QTimer;
+class FloorPlanItem;
+class SensorMarker;
 
 class BabyCare : public QGraphicsView
 {
@@ -10,13 +16,26 @@ class BabyCare : public QGraphicsView
 public:
     BabyCare(QWidget *parent = 0);
 
+public slots:
+    void sensorEnabled(int identity, bool enabled);
+
 protected:
     virtual void resizeEvent(QResizeEvent *event);
+    virtual void showEvent(QShowEvent *event);
+    virtual void hideEvent(QHideEvent *event);
+
+private slots:
+    void updateStream();
+
+private:
+    void createMarkers();
 
 private:
     QGraphicsScene *sense;
-    QGraphicsPixmapItem *mapItem;
-    QPixmap map;
+    FloorPlanItem *mapItem;
+    QMap<int, SensorMarker *> markers;
+    QGraphicsSimpleTextItem *streamItem;
+    QTimer *streamTimer;
 };
 
 #endif // BABYCARE_H
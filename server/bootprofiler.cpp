@@ -0,0 +1,173 @@
+#include <QApplication>
+#include <QWidget>
+#include <QEvent>
+#include <QFile>
+#include <QTextStream>
+#include <QTimer>
+#include <QDebug>
+
+#include "settings.h"
+#include "watertower.h"
+#include "bootprofiler.h"
+
+BootProfiler *BootProfiler::self = 0;
+QElapsedTimer BootProfiler::clock;
+
+static const int DefaultTimeout = 120;     /*  measured in the unit of "second"  */
+
+BootProfiler::BootProfiler(QObject *parent) :
+    QObject(parent),
+    painted(false),
+    reported(false),
+    benchmark(false)
+{
+    if (!clock.isValid())
+        clock.start();
+    reportFile = Settings::dataDirectory() + "/boot-profile.txt";
+
+    /* a tower offline since boot must not keep the report from being written */
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), this, SLOT(reportTimeout()));
+    timer->start(DefaultTimeout * 1000);
+}
+
+BootProfiler *BootProfiler::instance()
+{
+    if (!self)
+        self = new BootProfiler();
+    return self;
+}
+
+/* static */
+void BootProfiler::startClock()
+{
+    clock.start();
+}
+
+void BootProfiler::mark(const QString &phase)
+{
+    Phase p;
+    p.name = phase;
+    p.nsec = clock.nsecsElapsed();
+    phases.append(p);
+    qDebug() << "Boot" << phase << p.nsec / 1000000.0 << "ms";
+}
+
+void BootProfiler::watchFirstPaint(QWidget *widget)
+{
+    widget->installEventFilter(this);
+}
+
+void BootProfiler::expectReading(int identity)
+{
+    if (!expectedReadings.contains(identity)) {
+        expectedReadings.insert(identity);
+        pendingReadings.insert(identity);
+    }
+}
+
+void BootProfiler::firstReading(int identity)
+{
+    /* kept apart from the phases, towers answer in any order */
+    if (pendingReadings.remove(identity)) {
+        qint64 nsec = clock.nsecsElapsed();
+        readings.insert(identity, nsec);
+        qDebug() << "Boot WaterTower" << identity << "first reading" << nsec / 1000000.0 << "ms";
+        if (reported && !benchmark)
+            writeReport();
+        else
+            checkFinished();
+    }
+}
+
+void BootProfiler::setReportFile(const QString &fileName)
+{
+    reportFile = fileName;
+}
+
+void BootProfiler::setBenchmark(int timeout)
+{
+    benchmark = true;
+    if (timeout <= 0)
+        timeout = DefaultTimeout;
+    timer->start(timeout * 1000);
+}
+
+bool BootProfiler::writeReport()
+{
+    QFile file(reportFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qDebug() << "Boot profile can not be written to" << reportFile;
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "# skynet boot profile\n";
+    out << "# build\t" << __DATE__ << " " << __TIME__ << "\n";
+    out << "# qt\t" << qVersion() << "\n";
+    out << "# phase\telapsed_ms\tdelta_ms\n";
+
+    qint64 previous = 0;
+    foreach (const Phase &p, phases) {
+        out << p.name << "\t"
+            << QString::number(p.nsec / 1000000.0, 'f', 3) << "\t"
+            << QString::number((p.nsec - previous) / 1000000.0, 'f', 3) << "\n";
+        previous = p.nsec;
+    }
+
+    /* every tower, so reports stay line aligned whichever towers answer */
+    qint64 lastReading = -1;
+    for (int identity = 0; identity < WaterTower::MaxQuantity; identity++) {
+        out << QString("WaterTower-%1 first reading").arg(identity) << "\t";
+        if (readings.contains(identity)) {
+            qint64 nsec = readings.value(identity);
+            out << QString::number(nsec / 1000000.0, 'f', 3) << "\t-\n";
+            lastReading = qMax(lastReading, nsec);
+        } else {
+            out << (expectedReadings.contains(identity) ? "none" : "disabled") << "\t-\n";
+        }
+    }
+
+    if (pendingReadings.isEmpty() && lastReading >= 0)
+        out << "boot-to-first-reading\t" << QString::number(lastReading / 1000000.0, 'f', 3) << "\t-\n";
+    else
+        out << "boot-to-first-reading\t-\t-\n";
+
+    reported = true;
+    return true;
+}
+
+bool BootProfiler::eventFilter(QObject *obj, QEvent *event)
+{
+    if (!painted && event->type() == QEvent::Paint) {
+        painted = true;
+        obj->removeEventFilter(this);
+        mark("first paint");
+        checkFinished();
+    }
+    return QObject::eventFilter(obj, event);
+}
+
+void BootProfiler::reportTimeout()
+{
+    if (!reported) {
+        qDebug() << "Boot profile timeout, still waiting for" << pendingReadings.count() << "tower(s)";
+        finish(1);
+    }
+}
+
+void BootProfiler::checkFinished()
+{
+    if (reported || !painted || !pendingReadings.isEmpty())
+        return;
+
+    finish(0);
+}
+
+void BootProfiler::finish(int exitCode)
+{
+    writeReport();
+    if (benchmark)
+        QCoreApplication::exit(exitCode);
+}
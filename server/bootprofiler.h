@@ -0,0 +1,77 @@
+#ifndef BOOTPROFILER_H
+#define BOOTPROFILER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QSet>
+
+class QWidget;
+class QTimer;
+
+/*
+ * Records how long each startup phase takes, measured from the top of main(),
+ * up to the first successful reading of every enabled water tower.
+ *
+ * The report is a tab separated text file with a fixed set of phase names so
+ * runs of different builds can be diffed line by line. The first readings
+ * follow the phases, one line per tower in identity order: "none" for an
+ * enabled tower that never answered, "disabled" for one not polled.
+ *
+ * It is written once every enabled tower answered, or after the timeout of
+ * --boot-benchmark, 120 seconds by default, with a tower offline since boot.
+ * Outside the benchmark a reading arriving later rewrites it.
+ */
+class BootProfiler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static BootProfiler *instance();
+    static void startClock();
+
+    void mark(const QString &phase);
+    void watchFirstPaint(QWidget *widget);
+    void expectReading(int identity);
+    void firstReading(int identity);
+
+    void setReportFile(const QString &fileName);
+    void setBenchmark(int timeout);
+
+    bool writeReport();
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event);
+
+private slots:
+    void reportTimeout();
+
+private:
+    explicit BootProfiler(QObject *parent = 0);
+    Q_DISABLE_COPY(BootProfiler)
+    void checkFinished();
+    void finish(int exitCode);
+
+private:
+    static BootProfiler *self;
+    static QElapsedTimer clock;
+
+    struct Phase {
+        QString name;
+        qint64 nsec;
+    };
+    QList<Phase> phases;
+
+    QSet<int> pendingReadings;
+    QSet<int> expectedReadings;
+    QMap<int, qint64> readings;     /*  first reading of a tower, measured in the unit of "nanosecond"  */
+    bool painted;
+    bool reported;
+    bool benchmark;
+    QString reportFile;
+    QTimer *timer;
+};
+
+#endif // BOOTPROFILER_H
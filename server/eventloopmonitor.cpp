@@ -0,0 +1,81 @@
+#include <QApplication>
+#include <QTimer>
+#include <QStringList>
+#include <QDebug>
+
+#include "settings.h"
+#include "watchdog.h"
+#include "eventloopmonitor.h"
+
+EventLoopMonitor *EventLoopMonitor::self = 0;
+
+static const int ProbeInterval = 100;
+static const int WatchdogDeadline = 10 * 1000;
+static const int ReportInterval = 60 * 60 * 1000;
+
+EventLoopMonitor::EventLoopMonitor(QObject *parent) :
+    QObject(parent),
+    lagHistogram(Buckets, 0),
+    maxLag(0),
+    lagSum(0),
+    stalls(0),
+    depth(0),
+    dispatchClass(0),
+    dispatchType(QEvent::None)
+{
+    stallThreshold = Settings::instance()->value("EventLoopStallThreshold", 200).toInt();
+
+    /* boot up to the first probe counts against the event loop too */
+    Watchdog::instance()->checkIn("event-loop", WatchdogDeadline);
+
+    probeTimer = new QTimer(this);
+    probeTimer->setTimerType(Qt::PreciseTimer);
+    connect(probeTimer, SIGNAL(timeout()), this, SLOT(probe()));
+    probeTimer->start(ProbeInterval);
+    probeClock.start();
+
+    reportTimer = new QTimer(this);
+    connect(reportTimer, SIGNAL(timeout()), this, SLOT(report()));
+    reportTimer->start(ReportInterval);
+}
+
+EventLoopMonitor *EventLoopMonitor::instance()
+{
+    if (!self)
+        self = new EventLoopMonitor(qApp);
+    return self;
+}
+
+void EventLoopMonitor::probe()
+{
+    qint64 lag = qMax(Q_INT64_C(0), probeClock.restart() - ProbeInterval);
+
+    int bucket = 0;
+    while (bucket < Buckets - 1 && lag >= (Q_INT64_C(1) << bucket))
+        bucket++;
+    lagHistogram[bucket]++;
+    lagSum += lag;
+
+    if (lag > maxLag)
+        maxLag = lag;
+    if (lag >= stallThreshold)
+        qDebug() << "Event loop lag" << lag << "ms";
+
+    Watchdog::instance()->checkIn("event-loop", WatchdogDeadline);
+}
+
+void EventLoopMonitor::report()
+{
+    QStringList buckets;
+    for (int i = 0; i < Buckets; i++)
+        buckets << QString::number(lagHistogram.at(i));
+    qDebug() << "Event loop lag histogram" << buckets.join(" ") << "max" << maxLag << "ms, stalls" << stalls;
+}
+
+void EventLoopMonitor::stalled()
+{
+    stalls++;
+    /* see QEvent::Type, e.g. 1 timer, 43 queued slot, 52 deferred delete */
+    qDebug() << "Event loop stall" << dispatchClock.elapsed() << "ms dispatching event"
+             << dispatchType << "to" << dispatchClass;
+}
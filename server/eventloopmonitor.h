@@ -0,0 +1,98 @@
+#ifndef EVENTLOOPMONITOR_H
+#define EVENTLOOPMONITOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QVector>
+
+class QTimer;
+
+/*
+ * Watches the GUI event loop.
+ *
+ * A precise probe timer measures how late it is dispatched and keeps a
+ * histogram of that lag, in power of two millisecond buckets. It also checks
+ * the event loop in with the Watchdog. Application::notify() reports every
+ * top level dispatch, those running longer than the stall threshold are
+ * logged with their event type and receiver class.
+ */
+class EventLoopMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    static EventLoopMonitor *instance();
+
+    static bool exists()
+    {
+        return self != 0;
+    }
+
+    void dispatchStarted(QObject *receiver, QEvent *event)
+    {
+        if (depth++ == 0) {
+            /* the receiver may be deleted by the event, keep only its class */
+            dispatchClass = receiver->metaObject()->className();
+            dispatchType = event->type();
+            dispatchClock.start();
+        }
+    }
+
+    void dispatchFinished()
+    {
+        if (--depth == 0 && dispatchClock.elapsed() >= stallThreshold)
+            stalled();
+    }
+
+    /* bucket i counts lags below 2^i ms, the last one everything above */
+    QVector<quint32> histogram() const
+    {
+        return lagHistogram;
+    }
+
+    qint64 maximumLag() const
+    {
+        return maxLag;
+    }
+
+    qint64 totalLag() const
+    {
+        return lagSum;
+    }
+
+    quint32 stallCount() const
+    {
+        return stalls;
+    }
+
+    static const int Buckets = 14;
+
+private slots:
+    void probe();
+    void report();
+
+private:
+    explicit EventLoopMonitor(QObject *parent = 0);
+    Q_DISABLE_COPY(EventLoopMonitor)
+    void stalled();
+
+private:
+    static EventLoopMonitor *self;
+
+    QTimer *probeTimer;
+    QTimer *reportTimer;
+    QElapsedTimer probeClock;
+    QVector<quint32> lagHistogram;
+    qint64 maxLag;
+    qint64 lagSum;
+    quint32 stalls;
+    int stallThreshold;     /*  measured in the unit of "millisecond"  */
+
+    int depth;
+    const char *dispatchClass;
+    int dispatchType;
+    QElapsedTimer dispatchClock;
+};
+
+#endif // EVENTLOOPMONITOR_H
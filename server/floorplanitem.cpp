@@ -0,0 +1,229 @@
+#include <QApplication>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QImageReader>
+#include <QPixmapCache>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QSettings>
+#include <QDir>
+#include <QThread>
+#include <QDebug>
+
+#include "settings.h"
+#include "floorplanitem.h"
+
+const int FloorPlanItem::TileSize = 256;
+
+/* cuts the source image into the pyramid, off the GUI thread */
+class PyramidBuilder : public QThread
+{
+public:
+    PyramidBuilder(const QString &fileName, const QString &cacheDir, const QString &key, QObject *parent = 0) :
+        QThread(parent),
+        fileName(fileName),
+        cacheDir(cacheDir),
+        key(key),
+        succeeded(false)
+    {
+    }
+
+    bool hasSucceeded() const
+    {
+        return succeeded;
+    }
+
+protected:
+    virtual void run()
+    {
+        succeeded = build();
+    }
+
+private:
+    bool build()
+    {
+        QImage image(fileName);
+        if (image.isNull()) {
+            qDebug() << "Floor plan can not be decoded" << fileName;
+            return false;
+        }
+
+        qDebug() << "Building floor plan tiles" << cacheDir;
+
+        QSize size = image.size();
+        int levels = FloorPlanItem::levelCount(size);
+        int tileSize = FloorPlanItem::TileSize;
+        for (int level = 0; level < levels; level++) {
+            if (level > 0) {
+                image = image.scaled((image.width() + 1) / 2, (image.height() + 1) / 2,
+                                     Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+
+            QDir().mkpath(QString("%1/%2").arg(cacheDir).arg(level));
+            for (int y = 0; y < image.height(); y += tileSize) {
+                for (int x = 0; x < image.width(); x += tileSize) {
+                    if (isInterruptionRequested())
+                        return false;
+                    QString path = FloorPlanItem::tilePath(cacheDir, level, x / tileSize, y / tileSize);
+                    QRect rect = QRect(x, y, tileSize, tileSize) & image.rect();
+                    if (!image.copy(rect).save(path, "PNG")) {
+                        qDebug() << "Floor plan tile can not be written" << path;
+                        return false;
+                    }
+                }
+            }
+        }
+
+        /* written last, an interrupted build is simply redone next time */
+        QSettings manifest(cacheDir + "/manifest.ini", QSettings::IniFormat);
+        manifest.setValue("key", key);
+        manifest.setValue("size", size);
+        manifest.setValue("levels", levels);
+        manifest.sync();
+
+        return true;
+    }
+
+private:
+    QString fileName;
+    QString cacheDir;
+    QString key;
+    bool succeeded;
+};
+
+FloorPlanItem::FloorPlanItem(const QString &fileName, QGraphicsItem *parent) :
+    QGraphicsObject(parent),
+    levels(0),
+    ready(false),
+    builder(0)
+{
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+
+    QFileInfo info(fileName);
+    if (!info.exists()) {
+        qDebug() << "Floor plan not found" << fileName;
+        return;
+    }
+
+    QByteArray stamp = info.absoluteFilePath().toUtf8()
+            + QByteArray::number(info.size())
+            + QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+    key = QCryptographicHash::hash(stamp, QCryptographicHash::Md5).toHex().left(16);
+    cacheDir = QString("%1/cache/floorplan/%2").arg(Settings::dataDirectory()).arg(key);
+
+    if (loadManifest()) {
+        ready = true;
+        return;
+    }
+
+    /* the header alone, the scene is laid out before the tiles exist */
+    size = QImageReader(fileName).size();
+    if (size.isEmpty()) {
+        qDebug() << "Floor plan can not be decoded" << fileName;
+        return;
+    }
+    levels = levelCount(size);
+
+    builder = new PyramidBuilder(fileName, cacheDir, key, this);
+    connect(builder, SIGNAL(finished()), this, SLOT(pyramidBuilt()));
+    builder->start(QThread::LowPriority);
+}
+
+FloorPlanItem::~FloorPlanItem()
+{
+    if (builder) {
+        builder->requestInterruption();
+        builder->wait();
+    }
+}
+
+QRectF FloorPlanItem::boundingRect() const
+{
+    return QRectF(QPointF(0, 0), size);
+}
+
+void FloorPlanItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(widget);
+
+    if (!ready)
+        return;
+
+    /* coarsest level whose resolution still covers the device pixels */
+    qreal scale = option->levelOfDetailFromTransform(painter->worldTransform());
+    int level = 0;
+    while (level + 1 < levels && scale <= 0.5) {
+        scale *= 2;
+        level++;
+    }
+
+    int span = TileSize << level;
+    QRectF exposed = option->exposedRect & boundingRect();
+    int firstColumn = int(exposed.left()) / span;
+    int lastColumn = int(exposed.right()) / span;
+    int firstRow = int(exposed.top()) / span;
+    int lastRow = int(exposed.bottom()) / span;
+
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int column = firstColumn; column <= lastColumn; column++) {
+            QPixmap pixmap = tile(level, column, row);
+            if (pixmap.isNull())
+                continue;
+            QRectF target(column * span, row * span,
+                          pixmap.width() << level, pixmap.height() << level);
+            painter->drawPixmap(target & boundingRect(), pixmap,
+                                QRectF(QPointF(0, 0), (target & boundingRect()).size() / (1 << level)));
+        }
+    }
+}
+
+bool FloorPlanItem::loadManifest()
+{
+    if (!QFile::exists(cacheDir + "/manifest.ini"))
+        return false;
+
+    QSettings manifest(cacheDir + "/manifest.ini", QSettings::IniFormat);
+    if (manifest.value("key").toString() != key)
+        return false;
+
+    size = manifest.value("size").toSize();
+    levels = manifest.value("levels", 0).toInt();
+    return levels > 0 && !size.isEmpty();
+}
+
+void FloorPlanItem::pyramidBuilt()
+{
+    ready = builder->hasSucceeded();
+    builder->deleteLater();
+    builder = 0;
+    update();
+}
+
+/* static, halving until the whole image fits a single tile */
+int FloorPlanItem::levelCount(const QSize &size)
+{
+    int levels = 1;
+    while (qMax(size.width() >> (levels - 1), size.height() >> (levels - 1)) > TileSize)
+        levels++;
+    return levels;
+}
+
+/* static */
+QString FloorPlanItem::tilePath(const QString &cacheDir, int level, int column, int row)
+{
+    return QString("%1/%2/%3_%4.png").arg(cacheDir).arg(level).arg(column).arg(row);
+}
+
+QPixmap FloorPlanItem::tile(int level, int column, int row) const
+{
+    QString cacheKey = QString("floorplan-%1-%2-%3-%4").arg(key).arg(level).arg(column).arg(row);
+    QPixmap pixmap;
+    if (!QPixmapCache::find(cacheKey, &pixmap) && !missing.contains(cacheKey)) {
+        pixmap.load(tilePath(cacheDir, level, column, row));
+        if (pixmap.isNull())
+            missing.insert(cacheKey);
+        else
+            QPixmapCache::insert(cacheKey, pixmap);
+    }
+    return pixmap;
+}
@@ -0,0 +1,62 @@
+#ifndef FLOORPLANITEM_H
+#define FLOORPLANITEM_H
+
+#include <QGraphicsObject>
+#include <QSize>
+#include <QSet>
+
+class PyramidBuilder;
+
+/*
+ * Floor plan drawn from a tile pyramid.
+ *
+ * The source image is cut once into 256x256 tiles at successive half
+ * resolutions and cached on disk next to the application. The cut runs on a
+ * low priority thread, the plan only shows up once it is done; its size is
+ * known from the image header right away. Scene coordinates
+ * are full resolution image pixels; painting picks the level matching the
+ * view scale and loads only the exposed tiles through QPixmapCache, so
+ * zooming, panning and resizing never rescale the original image. A tile
+ * missing on disk is remembered as such.
+ */
+class FloorPlanItem : public QGraphicsObject
+{
+    Q_OBJECT
+
+public:
+    explicit FloorPlanItem(const QString &fileName, QGraphicsItem *parent = 0);
+    ~FloorPlanItem();
+
+    bool isNull() const
+    {
+        return levels == 0;
+    }
+
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+    static const int TileSize;
+
+private slots:
+    void pyramidBuilt();
+
+private:
+    bool loadManifest();
+    QPixmap tile(int level, int column, int row) const;
+
+    friend class PyramidBuilder;
+    static int levelCount(const QSize &size);
+    static QString tilePath(const QString &cacheDir, int level, int column, int row);
+
+private:
+    QString cacheDir;
+    QString key;
+    QSize size;
+    int levels;
+    bool ready;             /*  all tiles on disk  */
+
+    PyramidBuilder *builder;
+    mutable QSet<QString> missing;  /*  cache keys of tiles that failed to load  */
+};
+
+#endif // FLOORPLANITEM_H
@@ -1,23 +1,70 @@
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <QFile>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QDateTime>
+#include <QDir>
+#include <QDebug>
 
 #include "settings.h"
 #include "hal.h"
 
 
 Hal *Hal::self = 0;
+QString Hal::root;
+
+/*
+ * Indexed by Output. Blue currently shares gpio296 with yellow on the board;
+ * setOutputs() merges writes to a shared line so one colour can not switch
+ * the other off within a batch.
+ */
+const char *Hal::gpioPath[] = {
+    "/sys/class/gpio/gpio295/value",
+    "/sys/class/gpio/gpio296/value",
+    "/sys/class/gpio/gpio296/value",
+    0
+};
 
-const char *Hal::RedLed = "/sys/class/gpio/gpio295/value";
-const char *Hal::YellowLed = "/sys/class/gpio/gpio296/value";
-const char *Hal::BlueLed = "/sys/class/gpio/gpio296/value";
+/* used instead of the gpio lines when the leds-gpio driver owns them */
+const char *Hal::ledClassPath[] = {
+    "/sys/class/leds/red",
+    "/sys/class/leds/yellow",
+    "/sys/class/leds/blue",
+    0
+};
 
 const char *Hal::brightness = "/sys/class/backlight/pwm-backlight.0/brightness";
 const char *Hal::maxBrightnes = "/sys/class/backlight/pwm-backlight.0/max_brightness";
 
+static const int FadeInterval = 40;
+
 Hal::Hal(QObject *parent) :
     QObject(parent),
-    isPowerOff(false)
+    writeLog(0),
+    isPowerOff(false),
+    backlight(-1),
+    fadeTarget(0),
+    fadeSteps(0)
 {
+    fadeTimer = new QTimer(this);
+    connect(fadeTimer, SIGNAL(timeout()), this, SLOT(fadeStep()));
 
+    if (isSimulated()) {
+        qDebug() << "Hal simulated under" << root;
+        writeLog = new QFile(root + "/writes.log", this);
+        if (!writeLog->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered))
+            qDebug() << "Hal write log can not be opened" << writeLog->fileName();
+    }
+}
+
+Hal::~Hal()
+{
+    foreach (int fd, handles) {
+        if (fd >= 0)
+            ::close(fd);
+    }
 }
 
 Hal *Hal::instance()
@@ -27,19 +74,32 @@ Hal *Hal::instance()
     return self;
 }
 
-void Hal::powerOn()
+/*
+ * Prefix every sysfs and device path with root, e.g. a directory built by
+ * tools/mkhwsim.sh. Must be called before the first instance() call.
+ */
+void Hal::setHardwareRoot(const QString &root)
+{
+    Hal::root = QDir::cleanPath(root);
+    if (Hal::root == "/")
+        Hal::root.clear();
+}
+
+void Hal::powerOn(int fade)
 {
     if (isPowerOff) {
         isPowerOff = false;
-        setBrightness(Settings::instance()->getBrightness());
+        fadeBrightness(Settings::instance()->getBrightness(), fade);
+        emit powerChanged(true);
     }
 }
 
-void Hal::powerOff()
+void Hal::powerOff(int fade)
 {
     if (!isPowerOff) {
         isPowerOff = true;
-        setBrightness(0);
+        fadeBrightness(0, fade);
+        emit powerChanged(false);
     }
 }
 
@@ -51,22 +111,199 @@ void Hal::togglePower()
         powerOff();
 }
 
+void Hal::setBrightness(int value)
+{
+    fadeTimer->stop();
+    if (backlight != value) {
+        backlight = value;
+        setValue(brightness, value);
+    }
+}
+
+/*
+ * Ramp the backlight to value in one step per brightness level, spread over
+ * msec; the pwm backlight only has a handful of levels.
+ */
+void Hal::fadeBrightness(int value, int msec)
+{
+    int distance = qAbs(value - backlight);
+    if (msec <= 0 || backlight < 0 || distance <= 1) {
+        setBrightness(value);
+        return;
+    }
+
+    fadeTarget = value;
+    fadeSteps = distance;
+    fadeTimer->start(qMax(FadeInterval, msec / distance));
+}
+
+void Hal::fadeStep()
+{
+    int value = backlight + (fadeTarget > backlight ? 1 : -1);
+    backlight = value;
+    setValue(brightness, value);
+    if (value == fadeTarget || --fadeSteps <= 0)
+        fadeTimer->stop();
+}
+
+void Hal::setOutput(Output output, int value)
+{
+    if (output == Backlight) {
+        setBrightness(value);
+        return;
+    }
+
+    stopBlink(output);
+    setValue(outputPath(output), value);
+}
+
+void Hal::setOutputs(const QMap<Output, int> &values)
+{
+    QMap<QString, int> merged;
+
+    QMap<Output, int>::const_iterator i;
+    for (i = values.constBegin(); i != values.constEnd(); ++i) {
+        if (i.key() == Backlight) {
+            setBrightness(i.value());
+            continue;
+        }
+        stopBlink(i.key());
+        QString path = outputPath(i.key());
+        merged[path] = qMax(merged.value(path, 0), i.value());
+    }
+
+    QMap<QString, int>::const_iterator j;
+    for (j = merged.constBegin(); j != merged.constEnd(); ++j)
+        setValue(j.key(), j.value());
+}
+
+/*
+ * Hand blinking over to the kernel "timer" led trigger, so no wakeups are
+ * needed in userspace. Returns false when the led class device is missing
+ * and the caller has to blink by itself.
+ */
+bool Hal::blinkLed(Output led, int onMsec, int offMsec)
+{
+    if (led == Backlight || !hasLedClass(led))
+        return false;
+
+    QString base = ledClassPath[led];
+    if (!blinking.value(led)) {
+        /* delay_on and delay_off are recreated with every trigger change */
+        release(base + "/delay_on");
+        release(base + "/delay_off");
+        setValue(base + "/trigger", QByteArray("timer"));
+        blinking[led] = true;
+    }
+    setValue(base + "/delay_on", onMsec);
+    setValue(base + "/delay_off", offMsec);
+    return true;
+}
+
 void Hal::setValue(const QString &sysfs, int value)
 {
-    QFile file(sysfs);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
-        file.write(QByteArray::number(value));
-        file.close();
+    setValue(sysfs, QByteArray::number(value));
+}
+
+void Hal::setValue(const QString &sysfs, const QByteArray &value)
+{
+    if (written.value(sysfs) == value)
+        return;
+
+    if (writeAttribute(sysfs, value))
+        written[sysfs] = value;
+}
+
+/*
+ * Unconditional write, safe from any thread. In a simulated tree the file
+ * is cut to the new value, as a sysfs attribute would read back, and the
+ * write is appended to writes.log as "<msecs since epoch> <path> <value>".
+ */
+bool Hal::writeAttribute(const QString &sysfs, const QByteArray &value)
+{
+    int fd = handle(sysfs, true);
+    if (fd < 0)
+        return false;
+
+    if (::pwrite(fd, value.constData(), value.size(), 0) != value.size())
+        return false;
+
+    if (writeLog) {
+        QMutexLocker locker(&mutex);
+        if (::ftruncate(fd, value.size()) != 0)
+            qDebug() << "Hal can not truncate" << sysfs;
+        writeLog->write(QString("%1 %2 %3\n").arg(QDateTime::currentMSecsSinceEpoch())
+                        .arg(sysfs).arg(QString::fromLatin1(value)).toLatin1());
     }
+    return true;
 }
 
 int Hal::getValue(const QString &sysfs)
 {
-    QFile file(sysfs);
-    if (file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
-        QByteArray buf = file.readAll().trimmed();
-        file.close();
-        return buf.toInt();
+    int fd = handle(sysfs, false);
+    if (fd < 0)
+        return -1;
+
+    char buf[32];
+    ssize_t len = ::pread(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return -1;
+    return QByteArray(buf, len).trimmed().toInt();
+}
+
+/* descriptors stay open for the lifetime of the process */
+int Hal::handle(const QString &sysfs, bool write)
+{
+    QMutexLocker locker(&mutex);
+    QHash<QString, int>::const_iterator i = handles.constFind(sysfs);
+    if (i != handles.constEnd())
+        return i.value();
+
+    QByteArray path = QFile::encodeName(root + sysfs);
+    int fd = ::open(path.constData(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        fd = ::open(path.constData(), (write ? O_WRONLY : O_RDONLY) | O_CLOEXEC);
+    if (fd < 0)
+        qDebug() << "Hal can not open" << sysfs;
+
+    /* failures are remembered too, missing attributes are not retried */
+    handles.insert(sysfs, fd);
+    return fd;
+}
+
+void Hal::release(const QString &sysfs)
+{
+    QMutexLocker locker(&mutex);
+    QHash<QString, int>::iterator i = handles.find(sysfs);
+    if (i != handles.end()) {
+        if (i.value() >= 0)
+            ::close(i.value());
+        handles.erase(i);
+    }
+    written.remove(sysfs);
+}
+
+QString Hal::outputPath(Output output) const
+{
+    if (hasLedClass(output))
+        return QString(ledClassPath[output]) + "/brightness";
+    return gpioPath[output];
+}
+
+bool Hal::hasLedClass(Output output) const
+{
+    static QHash<int, bool> probed;
+    if (!probed.contains(output))
+        probed[output] = ledClassPath[output] && QFile::exists(root + ledClassPath[output] + "/trigger");
+    return probed.value(output);
+}
+
+void Hal::stopBlink(Output output)
+{
+    if (blinking.value(output)) {
+        blinking[output] = false;
+        setValue(QString(ledClassPath[output]) + "/trigger", QByteArray("none"));
+        /* the trigger change resets brightness behind our back */
+        written.remove(outputPath(output));
     }
-    return -1;
 }
@@ -2,43 +2,76 @@
 #define HAL_H
 
 #include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+
+class QTimer;
+class QFile;
 
 class Hal : public QObject
 {
     Q_OBJECT
 
 public:
+    enum Output {
+        RedLed,
+        YellowLed,
+        BlueLed,
+        Backlight
+    };
+
     static Hal *instance();
 
+    static void setHardwareRoot(const QString &root);
+    static QString hardwareRoot()
+    {
+        return root;
+    }
+
+    static bool isSimulated()
+    {
+        return !root.isEmpty();
+    }
+
     bool isPowerOn()
     {
         return !isPowerOff;
     }
 
-    void powerOn();
-    void powerOff();
+    void powerOn(int fade = 0);
+    void powerOff(int fade = 0);
     void togglePower();
 
     void setRedLed(int value)
     {
-        setValue(RedLed, value);
+        setOutput(RedLed, value);
     }
 
     void setYellowLed(int value)
     {
-        setValue(YellowLed, value);
+        setOutput(YellowLed, value);
     }
 
     void setBlueLed(int value)
     {
-        setValue(BlueLed, value);
+        setOutput(BlueLed, value);
     }
 
-    void setBrightness(int value)
+    void setOutput(Output output, int value);
+    void setOutputs(const QMap<Output, int> &values);
+    bool blinkLed(Output led, int onMsec, int offMsec);
+
+    void setBrightness(int value);
+    void fadeBrightness(int value, int msec);
+
+    int getBrightness() const
     {
-        setValue(brightness, value);
+        return backlight;
     }
 
+    bool writeAttribute(const QString &sysfs, const QByteArray &value);
+
     int getMaxBrightness()
     {
         int value = getValue(maxBrightnes);
@@ -47,20 +80,45 @@ public:
         return value;
     }
 
+signals:
+    void powerChanged(bool on);
+
+private slots:
+    void fadeStep();
+
 private:
     explicit Hal(QObject *parent = 0);
+    ~Hal();
     Q_DISABLE_COPY(Hal)
     void setValue(const QString &sysfs, int value);
+    void setValue(const QString &sysfs, const QByteArray &value);
     int getValue(const QString &sysfs);
+    int handle(const QString &sysfs, bool write);
+    void release(const QString &sysfs);
+    QString outputPath(Output output) const;
+    bool hasLedClass(Output output) const;
+    void stopBlink(Output output);
 
 private:
     static Hal *self;
+    static QString root;
+
+    QFile *writeLog;
+    QMutex mutex;           /*  handles and writeLog, the watchdog thread writes too  */
 
     bool isPowerOff;
 
-    static const char *RedLed;
-    static const char *YellowLed;
-    static const char *BlueLed;
+    int backlight;
+    int fadeTarget;
+    int fadeSteps;
+    QTimer *fadeTimer;
+
+    QHash<QString, int> handles;        /*  sysfs attribute to open descriptor  */
+    QHash<QString, QByteArray> written; /*  last value written to an attribute  */
+    QHash<int, bool> blinking;
+
+    static const char *gpioPath[];
+    static const char *ledClassPath[];
 
     static const char *brightness;
     static const char *maxBrightnes;
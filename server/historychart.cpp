@@ -0,0 +1,176 @@
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QDateTime>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QDialogButtonBox>
+
+#include "watertower.h"
+#include "historychart.h"
+
+static const int MinimumSpan = 3600;
+
+HistoryChart::HistoryChart(WaterTower *waterTower, QWidget *parent) :
+    QWidget(parent),
+    waterTower(waterTower),
+    history(WaterLevelHistory::instance(waterTower->getIdentity())),
+    span(3600),
+    end(0),
+    pressX(0),
+    pressEnd(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    connect(history, SIGNAL(appended()), this, SLOT(appended()));
+}
+
+QSize HistoryChart::sizeHint() const
+{
+    return QSize(640, 320);
+}
+
+void HistoryChart::setSpan(int seconds)
+{
+    span = qBound(MinimumSpan, seconds, WaterLevelHistory::MaxAge);
+    update();
+}
+
+void HistoryChart::followLatest()
+{
+    end = 0;
+    update();
+}
+
+void HistoryChart::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+
+    QRect plot = plotRect();
+    quint32 to = endTime();
+    quint32 from = to > quint32(span) ? to - span : 0;
+    int maximum = qMax(1, waterTower->getHeight());
+
+    history->decimate(from, to, plot.width(), ranges);
+
+    painter.setPen(palette().color(QPalette::Mid));
+    painter.drawRect(plot.adjusted(0, 0, -1, -1));
+
+    QVector<QLine> lines;
+    lines.reserve(ranges.count());
+    for (int x = 0; x < ranges.count(); x++) {
+        const WaterLevelHistory::Range &range = ranges.at(x);
+        if (!range.valid)
+            continue;
+        int top = plot.bottom() - plot.height() * range.maximum / maximum;
+        int bottom = plot.bottom() - plot.height() * range.minimum / maximum;
+        lines.append(QLine(plot.left() + x, top, plot.left() + x, bottom));
+    }
+    painter.setPen(QColor(0, 0, 255));
+    painter.drawLines(lines);
+
+    painter.setPen(palette().color(QPalette::Text));
+    QString format = span > 24 * 3600 ? "MM/dd HH:mm" : "HH:mm:ss";
+    QRect labels(plot.left(), plot.bottom() + 2, plot.width(), height() - plot.bottom() - 2);
+    painter.drawText(labels, Qt::AlignLeft | Qt::AlignTop,
+                     QDateTime::fromSecsSinceEpoch(from).toString(format));
+    painter.drawText(labels, Qt::AlignRight | Qt::AlignTop,
+                     end ? QDateTime::fromSecsSinceEpoch(to).toString(format) : tr("Now"));
+    painter.drawText(QRect(0, plot.top(), plot.left() - 4, fontMetrics().height()),
+                     Qt::AlignRight | Qt::AlignTop, QString::number(maximum));
+    painter.drawText(QRect(0, plot.bottom() - fontMetrics().height(), plot.left() - 4, fontMetrics().height()),
+                     Qt::AlignRight | Qt::AlignBottom, "0");
+}
+
+void HistoryChart::mousePressEvent(QMouseEvent *event)
+{
+    pressX = event->x();
+    pressEnd = endTime();
+    event->accept();
+}
+
+void HistoryChart::mouseMoveEvent(QMouseEvent *event)
+{
+    int width = qMax(1, plotRect().width());
+    qint64 offset = qint64(event->x() - pressX) * span / width;
+    qint64 target = qint64(pressEnd) - offset;
+    quint32 latest = quint32(QDateTime::currentDateTimeUtc().toSecsSinceEpoch());
+
+    if (target >= latest) {
+        end = 0;
+    } else {
+        quint32 earliest = history->firstTime() + span;
+        end = quint32(qMax<qint64>(target, earliest));
+    }
+    update();
+    event->accept();
+}
+
+void HistoryChart::wheelEvent(QWheelEvent *event)
+{
+    if (event->angleDelta().y() > 0)
+        setSpan(span / 2);
+    else if (event->angleDelta().y() < 0)
+        setSpan(span * 2);
+    event->accept();
+}
+
+void HistoryChart::appended()
+{
+    /* a scrubbed chart does not move, nothing to repaint */
+    if (end == 0 && isVisible())
+        update();
+}
+
+quint32 HistoryChart::endTime() const
+{
+    return end ? end : quint32(QDateTime::currentDateTimeUtc().toSecsSinceEpoch());
+}
+
+QRect HistoryChart::plotRect() const
+{
+    int margin = fontMetrics().height();
+    int left = fontMetrics().horizontalAdvance("00000") + 4;
+    return QRect(left, margin / 2, width() - left - margin / 2, height() - margin / 2 - margin - 2);
+}
+
+HistoryDialog::HistoryDialog(WaterTower *waterTower, const QString &title, QWidget *parent) :
+    QDialog(parent)
+{
+    setWindowTitle(title);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    HistoryChart *chart = new HistoryChart(waterTower, this);
+
+    QHBoxLayout *spans = new QHBoxLayout();
+    static const struct {
+        const char *text;
+        int seconds;
+    } presets[] = {
+        { QT_TR_NOOP("Hour"), 3600 },
+        { QT_TR_NOOP("Day"), 24 * 3600 },
+        { QT_TR_NOOP("Week"), 7 * 24 * 3600 },
+        { QT_TR_NOOP("Month"), 31 * 24 * 3600 },
+    };
+    for (unsigned int i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+        QPushButton *button = new QPushButton(tr(presets[i].text), this);
+        int seconds = presets[i].seconds;
+        connect(button, &QPushButton::clicked, chart, [chart, seconds]() { chart->setSpan(seconds); });
+        spans->addWidget(button);
+    }
+
+    QPushButton *latest = new QPushButton(tr("Now"), this);
+    connect(latest, SIGNAL(clicked()), chart, SLOT(followLatest()));
+    spans->addStretch();
+    spans->addWidget(latest);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+
+    layout->addLayout(spans);
+    layout->addWidget(chart, 1);
+    layout->addWidget(buttons);
+}
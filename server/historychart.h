@@ -0,0 +1,64 @@
+#ifndef HISTORYCHART_H
+#define HISTORYCHART_H
+
+#include <QDialog>
+#include <QWidget>
+#include <QVector>
+
+#include "waterlevelhistory.h"
+
+class WaterTower;
+
+/*
+ * Water level trend of one tower.
+ *
+ * Every repaint reduces the visible time span to one min/max range per pixel
+ * column, so the cost depends on the width of the widget rather than on the
+ * number of samples. Dragging scrubs back through time, the wheel zooms.
+ */
+class HistoryChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryChart(WaterTower *waterTower, QWidget *parent = 0);
+
+    virtual QSize sizeHint() const;
+
+public slots:
+    void setSpan(int seconds);
+    void followLatest();
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void wheelEvent(QWheelEvent *event);
+
+private slots:
+    void appended();
+
+private:
+    quint32 endTime() const;
+    QRect plotRect() const;
+
+private:
+    WaterTower *waterTower;
+    WaterLevelHistory *history;
+    QVector<WaterLevelHistory::Range> ranges;
+
+    int span;           /*  visible time span, measured in the unit of "second"  */
+    quint32 end;        /*  right edge of the chart, zero follows the latest sample  */
+    int pressX;
+    quint32 pressEnd;
+};
+
+class HistoryDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    HistoryDialog(WaterTower *waterTower, const QString &title, QWidget *parent = 0);
+};
+
+#endif // HISTORYCHART_H
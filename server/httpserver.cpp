@@ -0,0 +1,474 @@
+#include <QApplication>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDateTime>
+#include <QTimer>
+#include <QUrl>
+#include <QDebug>
+
+#include "settings.h"
+#include "watertower.h"
+#include "watertowerwidget.h"
+#include "waterlevelhistory.h"
+#include "notifypanel.h"
+#include "alarmcontroller.h"
+#include "httpserver.h"
+
+HttpServer *HttpServer::self = 0;
+
+static const int MaxHeaderSize = 8 * 1024;
+static const qint64 MaxBodySize = 64 * 1024;
+static const qint64 MaxStreamBacklog = 256 * 1024;
+static const qint64 MaxResponseBacklog = 1024 * 1024;
+static const int StreamKeepAlive = 15 * 1000;
+static const int MaxBuckets = 4096;
+
+static const char *reason(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    default: return "Internal Server Error";
+    }
+}
+
+HttpServer::HttpServer(QObject *parent) :
+    QObject(parent)
+{
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        WaterTower *tower = WaterTower::instance(i);
+        connect(tower, SIGNAL(waterLevelChanged(int)), this, SLOT(waterLevelChanged(int)));
+        connect(tower, SIGNAL(deviceConnected()), this, SLOT(deviceConnected()));
+        connect(tower, SIGNAL(deviceDisconnected()), this, SLOT(deviceDisconnected()));
+        connect(tower, SIGNAL(highWaterLevelAlarm()), this, SLOT(highWaterLevelAlarm()));
+    }
+
+    keepAliveTimer = new QTimer(this);
+    connect(keepAliveTimer, SIGNAL(timeout()), this, SLOT(keepStreamsAlive()));
+    keepAliveTimer->start(StreamKeepAlive);
+
+    int port = Settings::instance()->value("HttpPort", 8080).toInt();
+    QHostAddress address(Settings::instance()->value("HttpAddress", "127.0.0.1").toString());
+
+    server = new QTcpServer(this);
+    connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+    if (port > 0 && !server->listen(address, port))
+        qDebug() << "Http can not listen on" << address.toString() << port << server->errorString();
+}
+
+HttpServer *HttpServer::instance()
+{
+    if (!self)
+        self = new HttpServer(qApp);
+    return self;
+}
+
+void HttpServer::newConnection()
+{
+    while (server->hasPendingConnections()) {
+        QTcpSocket *client = server->nextPendingConnection();
+        Connection connection;
+        connection.skip = 0;
+        connection.streaming = false;
+        connection.closing = false;
+        connections.insert(client, connection);
+        connect(client, SIGNAL(readyRead()), this, SLOT(readRequests()));
+        connect(client, SIGNAL(disconnected()), this, SLOT(clientClosed()));
+    }
+}
+
+void HttpServer::readRequests()
+{
+    QTcpSocket *client = qobject_cast<QTcpSocket *>(sender());
+    if (!client || !connections.contains(client))
+        return;
+
+    Connection &connection = connections[client];
+    if (connection.streaming) {
+        client->readAll();
+        return;
+    }
+    /* a peer still sending after a close, e.g. past a 400, is cut off */
+    if (connection.closing) {
+        client->abort();
+        return;
+    }
+    connection.input.append(client->readAll());
+
+    /* pipelined requests are answered in order, request bodies are skipped */
+    for (;;) {
+        /* nor may a peer pile up answers it never reads */
+        if (client->bytesToWrite() > MaxResponseBacklog) {
+            client->abort();
+            return;
+        }
+
+        /* a body may arrive in any number of reads after its header */
+        if (connection.skip > 0) {
+            int skipped = int(qMin(connection.skip, qint64(connection.input.size())));
+            connection.input.remove(0, skipped);
+            connection.skip -= skipped;
+            if (connection.skip > 0)
+                return;
+        }
+
+        int end = connection.input.indexOf("\r\n\r\n");
+        if (end < 0) {
+            if (connection.input.size() > MaxHeaderSize)
+                respond(client, 400, QByteArray(), false);
+            return;
+        }
+
+        QList<QByteArray> lines = connection.input.left(end).split('\n');
+        connection.input.remove(0, end + 4);
+
+        QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+        if (requestLine.count() != 3) {
+            respond(client, 400, QByteArray(), false);
+            return;
+        }
+
+        bool http11 = requestLine.at(2) == "HTTP/1.1";
+        bool keepAlive = http11;
+        qint64 contentLength = 0;
+        QByteArray authorization;
+        foreach (const QByteArray &line, lines) {
+            int colon = line.indexOf(':');
+            QByteArray name = line.left(colon).trimmed().toLower();
+            QByteArray value = line.mid(colon + 1).trimmed().toLower();
+            if (name == "authorization") {
+                /* the token is case sensitive */
+                authorization = line.mid(colon + 1).trimmed();
+            } else if (name == "connection") {
+                keepAlive = http11 ? value != "close" : value == "keep-alive";
+            } else if (name == "content-length") {
+                bool ok;
+                contentLength = value.toLongLong(&ok);
+                if (!ok || contentLength < 0 || contentLength > MaxBodySize) {
+                    respond(client, 400, QByteArray(), false);
+                    return;
+                }
+            }
+        }
+        connection.skip = contentLength;
+
+        QUrl url(QString::fromLatin1(requestLine.at(1)));
+        if (!handle(client, requestLine.at(0), url.path(), QUrlQuery(url), authorization, keepAlive)
+                || !keepAlive)
+            return;
+    }
+}
+
+void HttpServer::clientClosed()
+{
+    QTcpSocket *client = qobject_cast<QTcpSocket *>(sender());
+    connections.remove(client);
+    client->deleteLater();
+}
+
+/* Returns false once the connection no longer takes requests */
+bool HttpServer::handle(QTcpSocket *client, const QByteArray &method, const QString &path,
+                        const QUrlQuery &query, const QByteArray &authorization, bool keepAlive)
+{
+    if (method == "POST" && path.startsWith("/api/alarms/")) {
+        QByteArray body;
+        int status = authorize(authorization);
+        if (status == 200)
+            status = controlAlarm(path, query, &body);
+        respond(client, status, body, keepAlive);
+        return true;
+    }
+    if (method != "GET") {
+        respond(client, 405, QByteArray(), keepAlive);
+        return true;
+    }
+
+    if (path == "/api/config") {
+        respond(client, 200, config(), keepAlive);
+    } else if (path == "/api/state") {
+        respond(client, 200, state(), keepAlive);
+    } else if (path == "/api/history") {
+        bool ok;
+        QByteArray body = history(query, &ok);
+        respond(client, ok ? 200 : 400, body, keepAlive);
+    } else if (path == "/api/alarms") {
+        respond(client, 200, alarms(), keepAlive);
+    } else if (path == "/api/events") {
+        startStream(client);
+        return false;
+    } else {
+        respond(client, 404, QByteArray(), keepAlive);
+    }
+    return true;
+}
+
+void HttpServer::respond(QTcpSocket *client, int status, const QByteArray &body, bool keepAlive,
+                         const QByteArray &contentType)
+{
+    QByteArray header = "HTTP/1.1 " + QByteArray::number(status) + " " + reason(status) + "\r\n"
+            "Content-Type: " + contentType + "\r\n"
+            "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: " + (keepAlive ? "keep-alive" : "close") + "\r\n"
+            "\r\n";
+    client->write(header);
+    client->write(body);
+    if (!keepAlive) {
+        connections[client].closing = true;
+        connections[client].input.clear();
+        client->disconnectFromHost();
+    }
+}
+
+QByteArray HttpServer::config() const
+{
+    QJsonArray towers;
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        WaterTower *tower = WaterTower::instance(i);
+        QJsonObject object;
+        object["identity"] = i;
+        object["name"] = WaterTowerWidget::instance(i)->readableName(i);
+        object["enable"] = tower->isEnabled();
+        object["alarm"] = tower->isAlarmEnabled();
+        object["address"] = tower->getAddress();
+        object["radius"] = tower->getRadius();
+        object["levelSensorHeight"] = tower->getLevelSensorHeight();
+        object["numberOfSensors"] = tower->getSensorNumber();
+        towers.append(object);
+    }
+
+    QJsonObject root;
+    root["sampleInterval"] = WaterTower::getSampleInterval();
+    root["towers"] = towers;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray HttpServer::state() const
+{
+    QJsonArray towers;
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        WaterTower *tower = WaterTower::instance(i);
+        QJsonObject object;
+        object["identity"] = i;
+        object["enable"] = tower->isEnabled();
+        object["connected"] = tower->isDeviceConnected();
+        object["level"] = tower->getWaterLevel();
+        object["height"] = tower->getHeight();
+        object["alarm"] = tower->isAlarmActive();
+        towers.append(object);
+    }
+
+    QJsonObject root;
+    root["time"] = QDateTime::currentMSecsSinceEpoch() / 1000;
+    root["pendingAlarms"] = NotifyPanel::instance()->statistics().pending.load();
+    root["towers"] = towers;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray HttpServer::history(const QUrlQuery &query, bool *ok) const
+{
+    int tower = query.queryItemValue("tower").toInt(ok);
+    if (!*ok || tower < 0 || tower >= WaterTower::MaxQuantity)
+        return "{\"error\":\"tower\"}";
+
+    quint32 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    quint32 from = query.hasQueryItem("from") ? query.queryItemValue("from").toUInt() : now - 24 * 3600;
+    quint32 to = query.hasQueryItem("to") ? query.queryItemValue("to").toUInt() : now + 1;
+    int buckets = query.queryItemValue("buckets").toInt();
+    if (from >= to || buckets < 0 || buckets > MaxBuckets) {
+        *ok = false;
+        return "{\"error\":\"range\"}";
+    }
+
+    WaterLevelHistory *history = WaterLevelHistory::instance(tower);
+    QJsonArray values;
+    if (buckets > 0) {
+        QVector<WaterLevelHistory::Range> ranges;
+        history->decimate(from, to, buckets, ranges);
+        foreach (const WaterLevelHistory::Range &range, ranges) {
+            if (range.valid)
+                values.append(QJsonArray() << range.minimum << range.maximum);
+            else
+                values.append(QJsonValue());
+        }
+    } else {
+        foreach (const WaterLevelHistory::Sample &sample, history->samples(from, to))
+            values.append(QJsonArray() << qint64(sample.time) << sample.level);
+    }
+
+    QJsonObject root;
+    root["tower"] = tower;
+    root["from"] = qint64(from);
+    root["to"] = qint64(to);
+    root[buckets > 0 ? "ranges" : "samples"] = values;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray HttpServer::alarms() const
+{
+    QJsonArray rules;
+    foreach (const QString &name, AlarmController::instance()->rules())
+        rules.append(alarm(name));
+
+    QJsonObject root;
+    root["rules"] = rules;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QJsonObject HttpServer::alarm(const QString &name) const
+{
+    AlarmController *controller = AlarmController::instance();
+    QJsonObject object;
+    object["name"] = name;
+    object["active"] = controller->isActive(name);
+    object["acknowledged"] = controller->isAcknowledged(name);
+    object["paused"] = controller->isPaused(name);
+    object["snoozed"] = controller->snoozeRemaining(name);
+    return object;
+}
+
+/*
+ * Alarm rules are only controlled with HttpControl on and the HttpToken
+ * presented, returns the status to answer with. Compared in constant time
+ * so the token can not be guessed byte by byte from the response time.
+ */
+int HttpServer::authorize(const QByteArray &authorization) const
+{
+    Settings *settings = Settings::instance();
+    QByteArray token = settings->value("HttpToken").toString().toUtf8();
+    if (!settings->value("HttpControl", false).toBool() || token.isEmpty())
+        return 403;
+
+    static const QByteArray scheme = "bearer ";
+    if (authorization.left(scheme.size()).toLower() != scheme)
+        return 401;
+    QByteArray given = authorization.mid(scheme.size()).trimmed();
+
+    int difference = given.size() ^ token.size();
+    for (int i = 0; i < token.size(); i++)
+        difference |= token.at(i) ^ (i < given.size() ? given.at(i) : 0);
+    return difference == 0 ? 200 : 401;
+}
+
+/* /api/alarms/<name>/<action>, returns the status to answer with */
+int HttpServer::controlAlarm(const QString &path, const QUrlQuery &query, QByteArray *body)
+{
+    QString rest = path.mid(QString("/api/alarms/").size());
+    int slash = rest.lastIndexOf('/');
+    QString name = rest.left(slash);
+    QString action = rest.mid(slash + 1);
+
+    AlarmController *controller = AlarmController::instance();
+    if (slash <= 0 || !controller->contains(name)) {
+        *body = "{\"error\":\"rule\"}";
+        return 404;
+    }
+
+    if (action == "snooze") {
+        int seconds = AlarmController::snoozeTime();
+        if (query.hasQueryItem("seconds")) {
+            bool ok;
+            seconds = query.queryItemValue("seconds").toInt(&ok);
+            if (!ok || seconds <= 0) {
+                *body = "{\"error\":\"seconds\"}";
+                return 400;
+            }
+        }
+        controller->snooze(name, seconds);
+    } else if (action == "pause") {
+        controller->pause(name);
+    } else if (action == "resume") {
+        controller->resume(name);
+    } else if (action == "acknowledge") {
+        controller->acknowledge(name);
+    } else {
+        *body = "{\"error\":\"action\"}";
+        return 404;
+    }
+
+    *body = QJsonDocument(alarm(name)).toJson(QJsonDocument::Compact);
+    return 200;
+}
+
+void HttpServer::startStream(QTcpSocket *client)
+{
+    connections[client].streaming = true;
+    connections[client].input.clear();
+    client->write("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: text/event-stream\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Connection: keep-alive\r\n"
+                  "\r\n"
+                  "retry: 3000\n\n");
+}
+
+void HttpServer::publish(const QByteArray &event, const QByteArray &data)
+{
+    QHash<QTcpSocket *, Connection>::const_iterator i;
+    bool any = false;
+    for (i = connections.constBegin(); i != connections.constEnd() && !any; ++i)
+        any = i.value().streaming;
+    if (!any)
+        return;
+
+    QByteArray message = "event: " + event + "\ndata: " + data + "\n\n";
+
+    /* a stream that can not keep up is closed, the browser reconnects */
+    foreach (QTcpSocket *client, connections.keys()) {
+        if (!connections.contains(client) || !connections[client].streaming)
+            continue;
+        if (client->bytesToWrite() > MaxStreamBacklog)
+            client->abort();
+        else
+            client->write(message);
+    }
+}
+
+void HttpServer::waterLevelChanged(int centimetre)
+{
+    WaterTower *tower = qobject_cast<WaterTower *>(sender());
+    publish("reading", "{\"tower\":" + QByteArray::number(tower->getIdentity())
+            + ",\"level\":" + QByteArray::number(centimetre)
+            + ",\"time\":" + QByteArray::number(QDateTime::currentMSecsSinceEpoch() / 1000) + "}");
+}
+
+void HttpServer::deviceConnected()
+{
+    /*
+     * Emitted for every reply. WaterTower updates its own link state in a
+     * slot connected after this signal, so it still holds the old state.
+     */
+    WaterTower *tower = qobject_cast<WaterTower *>(sender());
+    if (!tower->isDeviceConnected())
+        publish("link", "{\"tower\":" + QByteArray::number(tower->getIdentity()) + ",\"connected\":true}");
+}
+
+void HttpServer::deviceDisconnected()
+{
+    WaterTower *tower = qobject_cast<WaterTower *>(sender());
+    if (tower->isDeviceConnected())
+        publish("link", "{\"tower\":" + QByteArray::number(tower->getIdentity()) + ",\"connected\":false}");
+}
+
+void HttpServer::highWaterLevelAlarm()
+{
+    WaterTower *tower = qobject_cast<WaterTower *>(sender());
+    publish("alarm", "{\"tower\":" + QByteArray::number(tower->getIdentity())
+            + ",\"level\":" + QByteArray::number(tower->getWaterLevel()) + "}");
+}
+
+/* a comment line, keeps proxies from timing idle streams out */
+void HttpServer::keepStreamsAlive()
+{
+    foreach (QTcpSocket *client, connections.keys()) {
+        if (connections[client].streaming && client->bytesToWrite() == 0)
+            client->write(": keep-alive\n\n");
+    }
+}
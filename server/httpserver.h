@@ -0,0 +1,88 @@
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QUrlQuery>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+class QJsonObject;
+
+/*
+ * Minimal HTTP/1.1 server for dashboards and scripts, event driven on the
+ * GUI thread. Connections are kept alive.
+ *
+ *   /api/config     tower configuration, as on the options page
+ *   /api/state      current level, link and alarm state of every tower
+ *   /api/history    ?tower=N&from=T&to=T[&buckets=B], times in epoch seconds;
+ *                   raw samples, or min/max per bucket when buckets is set
+ *   /api/events     server-sent events: reading, link and alarm
+ *   /api/alarms     alarm rules and their state
+ *
+ * The only POST requests control an alarm rule, answered with its state:
+ *
+ *   /api/alarms/<name>/snooze       [?seconds=S], by default AlarmSnooze
+ *   /api/alarms/<name>/pause
+ *   /api/alarms/<name>/resume
+ *   /api/alarms/<name>/acknowledge
+ *
+ * They are refused unless HttpControl=true and the request carries the
+ * HttpToken setting as "Authorization: Bearer <token>". HttpAddress is
+ * 127.0.0.1 by default, set it to 0.0.0.0 to serve the whole network.
+ *
+ * Responses are written as a header and a separately encoded body, an event
+ * is encoded once and the same buffer is written to every stream.
+ */
+class HttpServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static HttpServer *instance();
+
+private slots:
+    void newConnection();
+    void readRequests();
+    void clientClosed();
+    void waterLevelChanged(int centimetre);
+    void deviceConnected();
+    void deviceDisconnected();
+    void highWaterLevelAlarm();
+    void keepStreamsAlive();
+
+private:
+    explicit HttpServer(QObject *parent = 0);
+    Q_DISABLE_COPY(HttpServer)
+
+    struct Connection {
+        QByteArray input;
+        qint64 skip;        /*  bytes of a request body still to come and be skipped  */
+        bool streaming;
+        bool closing;       /*  answered with Connection: close, takes nothing more  */
+    };
+
+    bool handle(QTcpSocket *client, const QByteArray &method, const QString &path,
+                const QUrlQuery &query, const QByteArray &authorization, bool keepAlive);
+    int authorize(const QByteArray &authorization) const;
+    void respond(QTcpSocket *client, int status, const QByteArray &body, bool keepAlive,
+                 const QByteArray &contentType = "application/json");
+    QByteArray config() const;
+    QByteArray state() const;
+    QByteArray history(const QUrlQuery &query, bool *ok) const;
+    QByteArray alarms() const;
+    QJsonObject alarm(const QString &name) const;
+    int controlAlarm(const QString &path, const QUrlQuery &query, QByteArray *body);
+    void startStream(QTcpSocket *client);
+    void publish(const QByteArray &event, const QByteArray &data);
+
+private:
+    static HttpServer *self;
+
+    QTcpServer *server;
+    QTimer *keepAliveTimer;
+    QHash<QTcpSocket *, Connection> connections;
+};
+
+#endif // HTTPSERVER_H
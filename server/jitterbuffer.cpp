@@ -0,0 +1,178 @@
+#include <math.h>
+#include <string.h>
+
+#include <QtEndian>
+
+#include "jitterbuffer.h"
+
+static const int ShrinkSlack = 2;       /*  frames above the target tolerated  */
+static const int ShrinkAfter = 50;      /*  pulls, half a second  */
+static const int ConcealFrames = 3;     /*  fade out a lost run over this many frames  */
+
+JitterBuffer::JitterBuffer() :
+    frames(Capacity),
+    slotSequence(Capacity),
+    jitter(0)
+{
+    for (int i = 0; i < Capacity; i++)
+        frames[i].resize(FrameBytes);
+    lastFrame.fill(0, FrameBytes);
+    reset();
+}
+
+void JitterBuffer::reset()
+{
+    slotSequence.fill(-1);
+    started = false;
+    playing = false;
+    played = false;
+    nextSequence = 0;
+    highestSequence = 0;
+    overTarget = 0;
+    lossRun = ConcealFrames;
+    haveArrival = false;
+    jitter = 0;
+    publish();
+}
+
+/* arrival is measured in the unit of "microsecond" on any monotonic clock */
+void JitterBuffer::push(quint16 sequence, quint32 timestamp, const char *pcm, qint64 arrival)
+{
+    stats.received.ref();
+
+    qint64 extended = unwrap(sequence);
+    if (started && qAbs(extended - nextSequence) >= Capacity) {
+        /* the sender restarted or was gone for long, start over */
+        double estimate = jitter;
+        reset();
+        jitter = estimate;
+        extended = unwrap(sequence);
+    }
+
+    /* interarrival jitter of RFC 3550, whatever the order packets come in */
+    if (haveArrival) {
+        qint64 spacing = qint64(qint32(timestamp - lastTimestamp)) * 1000000 / SampleRate;
+        double deviation = qAbs((arrival - lastArrival) - spacing);
+        jitter += (deviation - jitter) / 16;
+    }
+    haveArrival = true;
+    lastArrival = arrival;
+    lastTimestamp = timestamp;
+
+    if (!started) {
+        started = true;
+        nextSequence = extended;
+        highestSequence = extended;
+    } else if (extended < nextSequence) {
+        if (played || highestSequence - extended >= Capacity) {
+            stats.late.ref();
+            return;
+        }
+        /* overtaken while still filling up, nothing has been played yet */
+        nextSequence = extended;
+    }
+
+    int slot = extended % Capacity;
+    if (slotSequence.at(slot) == extended) {
+        stats.duplicates.ref();
+        return;
+    }
+    memcpy(frames[slot].data(), pcm, FrameBytes);
+    slotSequence[slot] = extended;
+    highestSequence = qMax(highestSequence, extended);
+    publish();
+}
+
+void JitterBuffer::pull(char *frame)
+{
+    if (!playing) {
+        if (!started || depth() < target()) {
+            conceal(frame);
+            publish();
+            return;
+        }
+        playing = true;
+    }
+
+    if (depth() == 0) {
+        stats.underruns.ref();
+        playing = false;
+        conceal(frame);
+        publish();
+        return;
+    }
+
+    if (depth() > target() + ShrinkSlack) {
+        if (++overTarget >= ShrinkAfter) {
+            slotSequence[nextSequence % Capacity] = -1;
+            nextSequence++;
+            overTarget = 0;
+            stats.discarded.ref();
+        }
+    } else {
+        overTarget = 0;
+    }
+
+    int slot = nextSequence % Capacity;
+    if (slotSequence.at(slot) == nextSequence) {
+        memcpy(frame, frames.at(slot).constData(), FrameBytes);
+        memcpy(lastFrame.data(), frame, FrameBytes);
+        slotSequence[slot] = -1;
+        lossRun = 0;
+    } else {
+        stats.lost.ref();
+        conceal(frame);
+    }
+    played = true;
+    nextSequence++;
+    publish();
+}
+
+qint64 JitterBuffer::unwrap(quint16 sequence)
+{
+    /* well clear of zero, so a frame overtaken by the first one stays positive */
+    if (!started)
+        return sequence + 0x10000;
+    return highestSequence + qint16(sequence - quint16(highestSequence));
+}
+
+/* frames from the one due up to the newest, holes included */
+int JitterBuffer::depth() const
+{
+    if (!started || highestSequence < nextSequence)
+        return 0;
+    return highestSequence - nextSequence + 1;
+}
+
+int JitterBuffer::target() const
+{
+    return qBound(MinDepth, 1 + int(ceil(3 * jitter / FrameDuration)), MaxDepth);
+}
+
+/* the last frame again, fading out, then silence */
+void JitterBuffer::conceal(char *frame)
+{
+    if (lossRun >= ConcealFrames) {
+        memset(frame, 0, FrameBytes);
+        return;
+    }
+
+    double from = 1.0 - double(lossRun) / ConcealFrames;
+    double to = 1.0 - double(lossRun + 1) / ConcealFrames;
+    const uchar *source = reinterpret_cast<const uchar *>(lastFrame.constData());
+    uchar *dest = reinterpret_cast<uchar *>(frame);
+    for (int i = 0; i < FrameSamples; i++) {
+        double gain = from + (to - from) * i / FrameSamples;
+        qint16 sample = qFromLittleEndian<qint16>(source + 2 * i);
+        qToLittleEndian<qint16>(qint16(sample * gain), dest + 2 * i);
+    }
+    lossRun++;
+    stats.concealed.ref();
+}
+
+void JitterBuffer::publish()
+{
+    stats.depth.store(depth());
+    stats.target.store(target());
+    stats.jitter.store(int(jitter));
+}
@@ -0,0 +1,90 @@
+#ifndef JITTERBUFFER_H
+#define JITTERBUFFER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QAtomicInt>
+
+/*
+ * Reorders the 10 ms frames of an audio stream and hands one out per pull.
+ *
+ * Interarrival jitter is estimated as in RFC 3550 and sets the target depth,
+ * between MinDepth and MaxDepth frames. Playout starts once the target is
+ * buffered and starts over after the buffer ran dry. A depth well above the
+ * target for half a second drops the oldest frame, so the delay follows the
+ * jitter down again. A missing frame is concealed by repeating the last one,
+ * fading it out over a few frames.
+ *
+ * Not thread safe, only the statistics may be read from other threads.
+ */
+class JitterBuffer
+{
+public:
+    static const int SampleRate = 16000;
+    static const int FrameSamples = 160;
+    static const int FrameBytes = FrameSamples * 2;     /*  mono, signed 16 bit little endian  */
+    static const int FrameDuration = 10000;             /*  measured in the unit of "microsecond"  */
+
+    static const int MinDepth = 2;
+    static const int MaxDepth = 12;
+    static const int Capacity = 32;
+
+    struct Statistics {
+        QAtomicInt received;
+        QAtomicInt lost;            /*  not there when it was due  */
+        QAtomicInt late;            /*  arrived after it was due  */
+        QAtomicInt duplicates;
+        QAtomicInt concealed;       /*  frames played from the concealment  */
+        QAtomicInt underruns;       /*  buffer ran dry, playout started over  */
+        QAtomicInt discarded;       /*  dropped to bring the delay down  */
+        QAtomicInt depth;           /*  frames buffered right now  */
+        QAtomicInt target;
+        QAtomicInt jitter;          /*  measured in the unit of "microsecond"  */
+    };
+
+    JitterBuffer();
+
+    void reset();
+    void push(quint16 sequence, quint32 timestamp, const char *pcm, qint64 arrival);
+    void pull(char *frame);
+
+    bool isPlaying() const
+    {
+        return playing;
+    }
+
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+private:
+    qint64 unwrap(quint16 sequence);
+    int depth() const;
+    int target() const;
+    void conceal(char *frame);
+    void publish();
+
+private:
+    QVector<QByteArray> frames;
+    QVector<qint64> slotSequence;   /*  sequence held by a slot, -1 when empty  */
+
+    bool started;
+    bool playing;
+    bool played;                    /*  any frame handed out since the start, playing or not now  */
+    qint64 nextSequence;            /*  the frame to play next  */
+    qint64 highestSequence;
+    int overTarget;                 /*  consecutive pulls with too much buffered  */
+
+    QByteArray lastFrame;
+    int lossRun;
+
+    bool haveArrival;
+    qint64 lastArrival;             /*  measured in the unit of "microsecond"  */
+    quint32 lastTimestamp;          /*  measured in samples  */
+    double jitter;
+
+    Statistics stats;
+};
+
+#endif // JITTERBUFFER_H
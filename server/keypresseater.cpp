@@ -1,18 +1,14 @@
 #include <QKeyEvent>
-#include <QTimer>
 #include <QDebug>
 
-#include "settings.h"
 #include "hal.h"
+#include "powermanager.h"
 #include "keypresseater.h"
 
 KeyPressEater::KeyPressEater(QObject *parent) :
     QObject(parent)
 {
-    timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), this, SLOT(ticktack()));
-    idleTime = Settings::instance()->getIdleTime();
-    timer->start(idleTime * 60 * 1000);
+    PowerManager::instance();
 }
 
 bool KeyPressEater::eventFilter(QObject *obj, QEvent *event)
@@ -26,12 +22,15 @@ bool KeyPressEater::eventFilter(QObject *obj, QEvent *event)
                     return true;
         }
     }
-    case QEvent::MouseMove:
     case QEvent::MouseButtonPress:
     case QEvent::MouseButtonDblClick:
-    case QEvent::Wheel:
+        PowerManager::instance()->touch();
         emit mouseActive();
-        timer->start(idleTime * 60 * 1000);
+        break;
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+        /* high rate input, only note the time */
+        PowerManager::instance()->touch();
         break;
     default:
         break;
@@ -39,27 +38,3 @@ bool KeyPressEater::eventFilter(QObject *obj, QEvent *event)
 
     return QObject::eventFilter(obj, event);
 }
-
-void KeyPressEater::setIdleTime(int value)
-{
-    idleTime = value;
-}
-
-void KeyPressEater::ticktack()
-{
-    if (!Hal::instance()->isPowerOn())
-        return;
-
-    const QTime &currentTime = QTime::currentTime();
-    const QTime &from = Settings::instance()->getIdleTimeFrom();
-    const QTime &to = Settings::instance()->getIdleTimeTo();
-
-    if (to < from) {
-        if (((currentTime > from) && (currentTime < QTime(23, 59, 0))) ||
-            ((currentTime > QTime(0, 0, 0)) && (currentTime < to)))
-            Hal::instance()->powerOff();
-    } else {
-        if ((currentTime > from) && (currentTime < to))
-            Hal::instance()->powerOff();
-    }
-}
@@ -3,8 +3,6 @@
 
 #include <QObject>
 
-class QTimer;
-
 class KeyPressEater : public QObject
 {
     Q_OBJECT
@@ -16,14 +14,6 @@ signals:
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event);
-
-private slots:
-    void setIdleTime(int value);
-    void ticktack();
-
-private:
-    QTimer *timer;
-    int idleTime;
 };
 
 #endif // KEYPRESSEATER_H
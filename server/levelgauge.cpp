@@ -0,0 +1,154 @@
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QLinearGradient>
+
+#include "levelgauge.h"
+
+static const int BorderWidth = 2;
+static const int BorderRadius = 5;
+
+LevelGauge::LevelGauge(QWidget *parent) :
+    QWidget(parent),
+    min(0),
+    max(100),
+    val(0),
+    connected(false)
+{
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Expanding);
+}
+
+QColor LevelGauge::levelColor() const
+{
+    int span = max - min;
+    if (span <= 0)
+        return QColor(colorRamp().at(0));
+
+    int index = 255 * (qBound(min, val, max) - min) / span;
+    return QColor(colorRamp().at(index));
+}
+
+QSize LevelGauge::sizeHint() const
+{
+    return QSize(24, 200);
+}
+
+QSize LevelGauge::minimumSizeHint() const
+{
+    return QSize(24, 2 * (BorderWidth + BorderRadius));
+}
+
+void LevelGauge::setRange(int minimum, int maximum)
+{
+    if (min == minimum && max == maximum)
+        return;
+
+    min = minimum;
+    max = maximum;
+    update();
+}
+
+void LevelGauge::setValue(int value)
+{
+    if (val == value)
+        return;
+
+    int before = levelY(val);
+    val = value;
+    int after = levelY(val);
+
+    /* disconnected gauges always show half height, nothing moves */
+    if (connected && before != after)
+        update(0, qMin(before, after), width(), qAbs(before - after));
+}
+
+void LevelGauge::setConnected(bool connected)
+{
+    if (this->connected == connected)
+        return;
+
+    this->connected = connected;
+    update();
+}
+
+void LevelGauge::paintEvent(QPaintEvent *event)
+{
+    if (fullPixmap.size() != size())
+        rebuildCache();
+
+    QPainter painter(this);
+
+    int y = levelY(connected ? val : (max - min) / 2 + min);
+    const QPixmap &filled = connected ? fullPixmap : idlePixmap;
+
+    for (const QRect &r : event->region()) {
+        QRect top = r & QRect(0, 0, width(), y);
+        if (!top.isEmpty())
+            painter.drawPixmap(top, emptyPixmap, top);
+        QRect bottom = r & QRect(0, y, width(), height() - y);
+        if (!bottom.isEmpty())
+            painter.drawPixmap(bottom, filled, bottom);
+    }
+}
+
+void LevelGauge::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    rebuildCache();
+}
+
+int LevelGauge::levelY(int value) const
+{
+    int inner = height() - 2 * BorderWidth;
+    int span = max - min;
+    if (span <= 0 || inner <= 0)
+        return height() - BorderWidth;
+
+    int filled = inner * (qBound(min, value, max) - min) / span;
+    return height() - BorderWidth - filled;
+}
+
+void LevelGauge::rebuildCache()
+{
+    QRectF frame = QRectF(rect()).adjusted(BorderWidth / 2.0, BorderWidth / 2.0,
+                                           -BorderWidth / 2.0, -BorderWidth / 2.0);
+    QPen pen(Qt::gray, BorderWidth);
+
+    QLinearGradient gradient(0, BorderWidth, 0, height() - BorderWidth);
+    const QVector<QRgb> &ramp = colorRamp();
+    gradient.setColorAt(0.0, QColor(ramp.last()));
+    gradient.setColorAt(1.0, QColor(ramp.first()));
+
+    struct {
+        QPixmap *pixmap;
+        QBrush brush;
+    } layers[] = {
+        { &fullPixmap, QBrush(gradient) },
+        { &emptyPixmap, palette().brush(QPalette::Base) },
+        { &idlePixmap, QBrush(Qt::lightGray) },
+    };
+
+    for (unsigned int i = 0; i < sizeof(layers) / sizeof(layers[0]); i++) {
+        QPixmap pixmap(size());
+        pixmap.fill(Qt::transparent);
+        QPainter painter(&pixmap);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(pen);
+        painter.setBrush(layers[i].brush);
+        painter.drawRoundedRect(frame, BorderRadius, BorderRadius);
+        painter.end();
+        *layers[i].pixmap = pixmap;
+    }
+}
+
+/* static */
+const QVector<QRgb> &LevelGauge::colorRamp()
+{
+    static QVector<QRgb> ramp;
+    if (ramp.isEmpty()) {
+        ramp.resize(256);
+        for (int i = 0; i < 256; i++)
+            ramp[i] = qRgb(i, 0, 255 - i);
+    }
+    return ramp;
+}
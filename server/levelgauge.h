@@ -0,0 +1,73 @@
+#ifndef LEVELGAUGE_H
+#define LEVELGAUGE_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <QVector>
+#include <QColor>
+
+/*
+ * Vertical water level bar.
+ *
+ * The blue to red gradient is rendered once per size into a pixmap and the
+ * bar is composed by blitting parts of it, so a new value only repaints the
+ * band between the old and the new level.
+ */
+class LevelGauge : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LevelGauge(QWidget *parent = 0);
+
+    int minimum() const
+    {
+        return min;
+    }
+
+    int maximum() const
+    {
+        return max;
+    }
+
+    int value() const
+    {
+        return val;
+    }
+
+    bool isConnected() const
+    {
+        return connected;
+    }
+
+    QColor levelColor() const;
+
+    virtual QSize sizeHint() const;
+    virtual QSize minimumSizeHint() const;
+
+public slots:
+    void setRange(int minimum, int maximum);
+    void setValue(int value);
+    void setConnected(bool connected);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+
+private:
+    int levelY(int value) const;
+    void rebuildCache();
+    static const QVector<QRgb> &colorRamp();
+
+private:
+    int min;
+    int max;
+    int val;
+    bool connected;
+
+    QPixmap fullPixmap;
+    QPixmap emptyPixmap;
+    QPixmap idlePixmap;
+};
+
+#endif // LEVELGAUGE_H
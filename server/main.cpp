@@ -1,35 +1,128 @@
-#include <QApplication>
 #include <QTranslator>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QTextStream>
 #include <QDebug>
 
+#include "alarmcontroller.h"
+#include "alarmjournal.h"
+#include "application.h"
+#include "audiostream.h"
+#include "bootprofiler.h"
+#include "eventloopmonitor.h"
+#include "hal.h"
 #include "watchdog.h"
+#include "httpserver.h"
 #include "keypresseater.h"
+#include "metricsserver.h"
+#include "settings.h"
+#include "soaktest.h"
+#include "telemetryserver.h"
+#include "watertower.h"
 #include "mainwindow.h"
 
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    BootProfiler::startClock();
+
+    Application a(argc, argv);
+    BootProfiler *profiler = BootProfiler::instance();
+    profiler->mark("QApplication");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption bootBenchmarkOption("boot-benchmark",
+            "Exit once every enabled water tower has been read, or after <seconds>.", "seconds");
+    parser.addOption(bootBenchmarkOption);
+    QCommandLineOption bootReportOption("boot-report",
+            "Write the boot profile to <file>.", "file");
+    parser.addOption(bootReportOption);
+    QCommandLineOption alarmStatisticsOption("alarm-statistics",
+            "Print alarm response times of the last <days> from the journal and exit.", "days");
+    parser.addOption(alarmStatisticsOption);
+    QCommandLineOption hardwareRootOption("hardware-root",
+            "Drive the simulated sysfs tree below <dir> instead of the hardware, see tools/mkhwsim.sh.", "dir");
+    parser.addOption(hardwareRootOption);
+    QCommandLineOption soakOption("soak",
+            "Run a soak test against the node simulator for <hours>, exit 1 on a failed limit.", "hours");
+    parser.addOption(soakOption);
+    QCommandLineOption soakReportOption("soak-report",
+            "Write the soak test samples and results to <file>.", "file");
+    parser.addOption(soakReportOption);
+    parser.process(a);
+
+    if (parser.isSet(alarmStatisticsOption)) {
+        /* next to a running skynet, which owns the journal */
+        AlarmJournal::setReadOnly(true);
+        qint64 to = QDateTime::currentMSecsSinceEpoch();
+        qint64 from = to - parser.value(alarmStatisticsOption).toLongLong() * 24 * 3600 * 1000;
+        AlarmJournal::Statistics statistics = AlarmJournal::instance()->statistics(from, to + 1);
+        QTextStream out(stdout);
+        out << "raised\t" << statistics.raised << "\n"
+            << "acknowledged\t" << statistics.acknowledged << "\n"
+            << "outstanding\t" << statistics.outstanding << "\n"
+            << "mean_ms\t" << statistics.mean << "\n"
+            << "median_ms\t" << statistics.median << "\n"
+            << "p95_ms\t" << statistics.percentile95 << "\n"
+            << "max_ms\t" << statistics.maximum << "\n";
+        return 0;
+    }
+
+    if (parser.isSet(hardwareRootOption))
+        Hal::setHardwareRoot(parser.value(hardwareRootOption));
+    else if (qEnvironmentVariableIsSet("SKYNET_HARDWARE_ROOT"))
+        Hal::setHardwareRoot(QString::fromLocal8Bit(qgetenv("SKYNET_HARDWARE_ROOT")));
+
+    if (parser.isSet(bootReportOption))
+        profiler->setReportFile(parser.value(bootReportOption));
+    if (parser.isSet(bootBenchmarkOption))
+        profiler->setBenchmark(parser.value(bootBenchmarkOption).toInt());
 
     QTranslator *translator = new QTranslator(&a);
     translator->load(":/skynet_zh_CN");
     //translator->load("qt_zh_CN");
     a.installTranslator(translator);
+    profiler->mark("translator load");
+
+    Watchdog *watchdog= Watchdog::instance();
+    watchdog->keepAlive();
+    EventLoopMonitor::instance();
+    profiler->mark("Watchdog open");
+
+    /* QSettings is lazy, force the ini file to be parsed within this phase */
+    Settings::instance()->childGroups();
+    profiler->mark("Settings parse");
 
     KeyPressEater *keyPressEater = new KeyPressEater();
     a.installEventFilter(keyPressEater);
 
     a.setStyleSheet("QDialog { background: cyan }");
 
-    Watchdog *watchdog= Watchdog::instance();
-    watchdog->keepAlive();
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        if (WaterTower::instance(i)->isEnabled())
+            profiler->expectReading(i);
+    }
+    profiler->mark("WaterTower instantiation");
+
+    if (parser.isSet(soakOption))
+        new SoakTest(parser.value(soakOption).toDouble(),
+                     parser.value(soakReportOption).isEmpty() ? "soak-report.txt" : parser.value(soakReportOption), &a);
 
     MainWindow w;
+    profiler->mark("widget construction");
+    AlarmController::instance();
+    profiler->watchFirstPaint(&w);
 #ifdef __arm__
     w.showFullScreen();
 #endif
     QObject::connect(keyPressEater, SIGNAL(mouseActive()), &w, SLOT(showLeftPanel()));
     w.show();
 
+    MetricsServer::instance();
+    TelemetryServer::instance();
+    HttpServer::instance();
+    AudioStream::instance();
+
     return a.exec();
 }
@@ -14,11 +14,14 @@
 
 #include "watertower.h"
 #include "watertowerwidget.h"
+#include "watertowergrid.h"
 #include "babycare.h"
 #include "datetimesettingsdialog.h"
 #include "mainwindow.h"
 #include "settings.h"
 #include "hal.h"
+#include "pcmplayer.h"
+#include "powermanager.h"
 #include "ui_mainwindow.h"
 
 QuickDialog::QuickDialog(const QString &label, int value, int minimum, int maximum, QWidget *parent) :
@@ -49,6 +52,8 @@ void QuickDialog::keyPressEvent(QKeyEvent *event)
     QDialog::keyPressEvent(event);
 }
 
+static const int PanelTimeout = 30000;
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
@@ -73,7 +78,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->listWidget->setCurrentRow(0);
 
     for (int i = 0; i < WaterTower::MaxQuantity; i++) {
-        connect(WaterTowerWidget::instance(i), SIGNAL(layoutChanged()), this, SLOT(waterTowerLayoutChanged()));
+        connect(WaterTowerWidget::instance(i), SIGNAL(layoutChanged(int,bool)), this, SLOT(waterTowerLayoutChanged(int,bool)));
     }
 
     dateTime = new QDateTimeEdit(QDateTime::currentDateTime(), this);
@@ -83,15 +88,15 @@ MainWindow::MainWindow(QWidget *parent) :
     dateTimeDisplayFormat();
     ui->statusBar->addPermanentWidget(dateTime);
 
-    QTimer *timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), this, SLOT(dateTimeUpdate()));
-    timer->start(1000);
+    dateTimeTimer = new QTimer(this);
+    connect(dateTimeTimer, SIGNAL(timeout()), this, SLOT(dateTimeUpdate()));
+    dateTimeTimer->start(1000);
 
     Hal::instance()->setBrightness(Settings::instance()->getBrightness());
+    connect(Hal::instance(), SIGNAL(powerChanged(bool)), this, SLOT(powerChanged(bool)));
 
-    player = new QMediaPlayer(this);
-    player->setMedia(QUrl::fromLocalFile(QString("%1/audios/%2.mp3").arg(qApp->applicationDirPath()).arg(QLatin1String("volume"))));
-    connect(player, SIGNAL(stateChanged(QMediaPlayer::State)), this, SLOT(playerStateChanged(QMediaPlayer::State)));
+    player = new PcmPlayer(this);
+    connect(player, SIGNAL(finished()), this, SLOT(previewFinished()));
 }
 
 MainWindow::~MainWindow()
@@ -101,12 +106,21 @@ MainWindow::~MainWindow()
 
 void MainWindow::showLeftPanel()
 {
-    ui->listWidget->setHidden(false);
-    hidePanelTimer->start(30000);
+    if (ui->listWidget->isHidden()) {
+        ui->listWidget->setHidden(false);
+        hidePanelTimer->start(PanelTimeout);
+    }
 }
 
 void MainWindow::hideLeftPanel()
 {
+    /* activity does not restart the timer, look at the last input instead */
+    qint64 idle = PowerManager::instance()->idleMsec();
+    if (idle < PanelTimeout) {
+        hidePanelTimer->start(PanelTimeout - idle);
+        return;
+    }
+
     ui->listWidget->setHidden(true);
     hidePanelTimer->stop();
 }
@@ -119,16 +133,12 @@ void MainWindow::pageChanged(QListWidgetItem *current, QListWidgetItem *previous
     ui->stackedWidget->setCurrentIndex(ui->listWidget->row(current));
 }
 
-void MainWindow::waterTowerLayoutChanged()
+void MainWindow::waterTowerLayoutChanged(int identity, bool enabled)
 {
-    QWidget *widget = ui->stackedWidget->widget(0);
-    QGridLayout *layout = qobject_cast<QGridLayout *>(widget->layout());
-    QLayoutItem *item;
-    while ((item = layout->takeAt(0)) != 0) {
-        item->widget()->setParent(0);
-        delete item;
-    }
-    insertWaterTowers(layout);
+    if (enabled)
+        waterTowerGrid->insertTower(identity);
+    else
+        waterTowerGrid->removeTower(identity);
 }
 
 void MainWindow::dateTimeUpdate()
@@ -147,19 +157,15 @@ void MainWindow::volumeChanged(int value)
     value *= 10;
     Settings::instance()->setVolume(value);
     player->setVolume(value);
-    if (player->state() == QMediaPlayer::StoppedState) {
+    if (!player->isPlaying()) {
         oneMoreCycle = false;
-        player->play();
-    } else if (player->state() == QMediaPlayer::PlayingState) {
-        qint64 duration = player->duration();
-        qint64 position = player->position();
-        if (position * 3 < duration) {
+        player->play("volume", false);
+    } else {
+        if (player->progress() * 3 < 1) {
             oneMoreCycle = false;
         } else {
             oneMoreCycle = true;
         }
-    } else {
-
     }
 }
 
@@ -196,11 +202,28 @@ void MainWindow::dateTimeSettings()
         dateTimeDisplayFormat();
 }
 
-void MainWindow::playerStateChanged(QMediaPlayer::State state)
+void MainWindow::previewFinished()
 {
-    if (state == QMediaPlayer::StoppedState && oneMoreCycle == true) {
+    if (oneMoreCycle == true) {
         oneMoreCycle = false;
-        player->play();
+        player->play("volume", false);
+    }
+}
+
+void MainWindow::powerChanged(bool on)
+{
+    /*
+     * Nothing is visible with the backlight off, stop the clock and block
+     * repaints; tower widgets keep only their latest reading meanwhile.
+     * Re-enabling updates repaints the whole window once.
+     */
+    if (on) {
+        dateTimeUpdate();
+        dateTimeTimer->start(1000);
+        setUpdatesEnabled(true);
+    } else {
+        dateTimeTimer->stop();
+        setUpdatesEnabled(false);
     }
 }
 
@@ -278,38 +301,17 @@ void MainWindow::createIcons()
             this, SLOT(pageChanged(QListWidgetItem*,QListWidgetItem*)));
 }
 
-void MainWindow::insertWaterTowers(QGridLayout *layout)
-{
-    static const struct {
-        int row;
-        int col;
-    } position[] = {
-        {0, 0},
-        {0, 1},
-        {0, 2},
-        {1, 0},
-        {1, 1},
-        {1, 2},
-    };
-
-    int pos = 0;
-    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
-        if (WaterTower::instance(i)->isEnabled()) {
-            layout->addWidget(WaterTowerWidget::instance(i), position[pos].row, position[pos].col);
-            pos++;
-        }
-    }
-}
-
 QWidget *MainWindow::createWaterTowers()
 {
-    QWidget *waterTowers= new QWidget(this);
-    QGridLayout *layout = new QGridLayout();
-    waterTowers->setLayout(layout);
+    waterTowerGrid = new WaterTowerGrid(this);
+    waterTowerGrid->setGrid(3, 2);
 
-    insertWaterTowers(layout);
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        if (WaterTower::instance(i)->isEnabled())
+            waterTowerGrid->insertTower(i);
+    }
 
-    return waterTowers;
+    return waterTowerGrid;
 }
 
 QWidget *MainWindow::createBabyCare()
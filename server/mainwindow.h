@@ -3,7 +3,6 @@
 
 #include <QDialog>
 #include <QMainWindow>
-#include <QMediaPlayer>
 
 namespace Ui {
 class MainWindow;
@@ -11,9 +10,10 @@ class MainWindow;
 
 class QDateTimeEdit;
 class QListWidgetItem;
-class QGridLayout;
 class QSlider;
 class QTimer;
+class PcmPlayer;
+class WaterTowerGrid;
 
 class QuickDialog : public QDialog
 {
@@ -48,13 +48,14 @@ public slots:
     void showLeftPanel();
     void hideLeftPanel();
     void pageChanged(QListWidgetItem *current, QListWidgetItem *previous);
-    void waterTowerLayoutChanged();
+    void waterTowerLayoutChanged(int identity, bool enabled);
     void dateTimeUpdate();
     void brightnessChanged(int value);
     void volumeChanged(int value);
     void idleTimeChanged(int index);
     void dateTimeSettings();
-    void playerStateChanged(QMediaPlayer::State state);
+    void previewFinished();
+    void powerChanged(bool on);
 
 protected:
     virtual void keyPressEvent(QKeyEvent *event);
@@ -63,7 +64,6 @@ protected:
 private:
     void dateTimeDisplayFormat();
     void createIcons();
-    void insertWaterTowers(QGridLayout *layout);
     QWidget *createWaterTowers();
     QWidget *createBabyCare();
     QWidget *createOptions();
@@ -76,7 +76,9 @@ private:
     QSlider *brightnessSilder;
     QSlider *volumeSilder;
     QDateTimeEdit *dateTime;
-    QMediaPlayer *player;
+    QTimer *dateTimeTimer;
+    WaterTowerGrid *waterTowerGrid;
+    PcmPlayer *player;
     bool oneMoreCycle;
 };
 
@@ -0,0 +1,343 @@
+#include <unistd.h>
+
+#include <QApplication>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include "settings.h"
+#include "multipointcom.h"
+#include "watertower.h"
+#include "notifypanel.h"
+#include "eventloopmonitor.h"
+#include "audiostream.h"
+#include "metricsserver.h"
+
+MetricsServer *MetricsServer::self = 0;
+
+static const int MaxRequestSize = 4096;
+
+static void family(QTextStream &out, const char *name, const char *type, const char *help)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " " << type << "\n";
+}
+
+MetricsServer::MetricsServer(QObject *parent) :
+    QObject(parent),
+    tcpServer(0),
+    localServer(0)
+{
+    int port = Settings::instance()->value("MetricsPort", 9105).toInt();
+    QHostAddress address(Settings::instance()->value("MetricsAddress", "127.0.0.1").toString());
+    QString socket = Settings::instance()->value("MetricsSocket", "").toString();
+
+    if (port > 0) {
+        tcpServer = new QTcpServer(this);
+        connect(tcpServer, SIGNAL(newConnection()), this, SLOT(newTcpConnection()));
+        if (!tcpServer->listen(address, port))
+            qDebug() << "Metrics can not listen on" << address.toString() << port << tcpServer->errorString();
+    }
+
+    if (!socket.isEmpty()) {
+        localServer = new QLocalServer(this);
+        connect(localServer, SIGNAL(newConnection()), this, SLOT(newLocalConnection()));
+        QLocalServer::removeServer(socket);
+        if (!localServer->listen(socket))
+            qDebug() << "Metrics can not listen on" << socket << localServer->errorString();
+    }
+}
+
+MetricsServer *MetricsServer::instance()
+{
+    if (!self)
+        self = new MetricsServer(qApp);
+    return self;
+}
+
+QByteArray MetricsServer::exposition() const
+{
+    QByteArray body;
+    QTextStream out(&body, QIODevice::WriteOnly);
+    writeRadio(out);
+    writeTowers(out);
+    writeAlarms(out);
+    writeEventLoop(out);
+    writeAudio(out);
+    writeMemory(out);
+    out.flush();
+    return body;
+}
+
+void MetricsServer::newTcpConnection()
+{
+    while (tcpServer->hasPendingConnections())
+        accept(tcpServer->nextPendingConnection());
+}
+
+void MetricsServer::newLocalConnection()
+{
+    while (localServer->hasPendingConnections())
+        accept(localServer->nextPendingConnection());
+}
+
+void MetricsServer::accept(QIODevice *client)
+{
+    requests.insert(client, QByteArray());
+    connect(client, SIGNAL(readyRead()), this, SLOT(readRequest()));
+    connect(client, SIGNAL(disconnected()), this, SLOT(clientClosed()));
+}
+
+void MetricsServer::readRequest()
+{
+    QIODevice *client = qobject_cast<QIODevice *>(sender());
+    if (!client || !requests.contains(client))
+        return;
+
+    QByteArray &request = requests[client];
+    request.append(client->readAll());
+    if (!request.contains("\r\n\r\n") && !request.contains("\n\n")) {
+        if (request.size() > MaxRequestSize)
+            client->close();
+        return;
+    }
+
+    QList<QByteArray> line = request.left(request.indexOf('\n')).trimmed().split(' ');
+    QByteArray path = line.value(1);
+    QByteArray response;
+    if (line.value(0) == "GET" && (path == "/metrics" || path == "/")) {
+        QByteArray body = exposition();
+        response = "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                   "\r\n" + body;
+    } else {
+        response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    }
+
+    requests.remove(client);
+    client->write(response);
+    /* both socket types flush pending data before disconnecting */
+    client->close();
+}
+
+void MetricsServer::clientClosed()
+{
+    QIODevice *client = qobject_cast<QIODevice *>(sender());
+    requests.remove(client);
+    client->deleteLater();
+}
+
+void MetricsServer::writeRadio(QTextStream &out) const
+{
+    const MultiPointCom::Statistics &stats = MultiPointCom::statistics();
+
+    family(out, "skynet_radio_requests_total", "counter", "Radio transfers started.");
+    out << "skynet_radio_requests_total " << stats.requests.load() << "\n";
+    family(out, "skynet_radio_lost_total", "counter", "Transfers without a reply from the addressed tower.");
+    out << "skynet_radio_lost_total " << stats.lost.load() << "\n";
+    family(out, "skynet_radio_resets_total", "counter", "Radio resets after 30 s without any reply.");
+    out << "skynet_radio_resets_total " << stats.resets.load() << "\n";
+    family(out, "skynet_radio_queue_depth", "gauge", "Transfers waiting for the radio.");
+    out << "skynet_radio_queue_depth " << stats.waiting.load() << "\n";
+
+    family(out, "skynet_radio_rtt_seconds", "histogram", "Round trip time of answered transfers.");
+    int cumulative = 0;
+    for (int i = 0; i < MultiPointCom::RttBuckets - 1; i++) {
+        cumulative += stats.rttBuckets[i].load();
+        out << "skynet_radio_rtt_seconds_bucket{le=\"" << MultiPointCom::rttBound[i] / 1000.0 << "\"} "
+            << cumulative << "\n";
+    }
+    cumulative += stats.rttBuckets[MultiPointCom::RttBuckets - 1].load();
+    out << "skynet_radio_rtt_seconds_bucket{le=\"+Inf\"} " << cumulative << "\n"
+        << "skynet_radio_rtt_seconds_sum " << stats.rttSum.load() / 1000.0 << "\n"
+        << "skynet_radio_rtt_seconds_count " << cumulative << "\n";
+
+    writeLanes(out);
+}
+
+static void laneHistogram(QTextStream &out, const char *name, const char *lane,
+                          const QAtomicInt *buckets, const QAtomicInteger<qint64> &sum)
+{
+    int cumulative = 0;
+    for (int i = 0; i < MultiPointCom::RttBuckets - 1; i++) {
+        cumulative += buckets[i].load();
+        out << name << "_bucket{lane=\"" << lane << "\",le=\"" << MultiPointCom::rttBound[i] / 1000.0 << "\"} "
+            << cumulative << "\n";
+    }
+    cumulative += buckets[MultiPointCom::RttBuckets - 1].load();
+    out << name << "_bucket{lane=\"" << lane << "\",le=\"+Inf\"} " << cumulative << "\n"
+        << name << "_sum{lane=\"" << lane << "\"} " << sum.load() / 1000.0 << "\n"
+        << name << "_count{lane=\"" << lane << "\"} " << cumulative << "\n";
+}
+
+void MetricsServer::writeLanes(QTextStream &out) const
+{
+    const MultiPointCom::Statistics &stats = MultiPointCom::statistics();
+
+    struct Counter {
+        const char *name;
+        const char *help;
+        QAtomicInt MultiPointCom::LaneStatistics::*member;
+    };
+    static const Counter counters[] = {
+        { "skynet_radio_lane_requests_total", "Transfers granted the radio, by priority lane.", &MultiPointCom::LaneStatistics::requests },
+        { "skynet_radio_lane_preempted_total", "Background transfers that gave the radio up to a higher lane.", &MultiPointCom::LaneStatistics::preempted },
+        { "skynet_radio_lane_overruns_total", "Urgent transfers queued longer than their bound.", &MultiPointCom::LaneStatistics::overruns }
+    };
+
+    for (unsigned i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+        family(out, counters[i].name, "counter", counters[i].help);
+        for (int lane = 0; lane < MultiPointCom::Lanes; lane++) {
+            out << counters[i].name << "{lane=\"" << MultiPointCom::priorityName(MultiPointCom::Priority(lane)) << "\"} "
+                << (stats.lanes[lane].*counters[i].member).load() << "\n";
+        }
+    }
+
+    family(out, "skynet_radio_lane_wait_seconds", "histogram", "Time queued for the radio, by priority lane.");
+    for (int lane = 0; lane < MultiPointCom::Lanes; lane++) {
+        laneHistogram(out, "skynet_radio_lane_wait_seconds", MultiPointCom::priorityName(MultiPointCom::Priority(lane)),
+                      stats.lanes[lane].waitBuckets, stats.lanes[lane].waitSum);
+    }
+
+    family(out, "skynet_radio_lane_rtt_seconds", "histogram", "Round trip time of answered transfers, by priority lane.");
+    for (int lane = 0; lane < MultiPointCom::Lanes; lane++) {
+        laneHistogram(out, "skynet_radio_lane_rtt_seconds", MultiPointCom::priorityName(MultiPointCom::Priority(lane)),
+                      stats.lanes[lane].rttBuckets, stats.lanes[lane].rttSum);
+    }
+}
+
+void MetricsServer::writeTowers(QTextStream &out) const
+{
+    /* every tower, a series that comes and goes with the option breaks rate() */
+    QList<WaterTower *> towers;
+    for (int i = 0; i < WaterTower::MaxQuantity; i++)
+        towers.append(WaterTower::instance(i));
+
+    struct Counter {
+        const char *name;
+        const char *help;
+        QAtomicInt WaterTower::Statistics::*member;
+    };
+    static const Counter counters[] = {
+        { "skynet_tower_polls_total", "Polls scheduled.", &WaterTower::Statistics::polls },
+        { "skynet_tower_polls_busy_total", "Polls skipped, the previous transfer was still running.", &WaterTower::Statistics::busy },
+        { "skynet_tower_readings_total", "Valid level readings.", &WaterTower::Statistics::readings },
+        { "skynet_tower_rejected_total", "Malformed or out of range replies.", &WaterTower::Statistics::rejected },
+        { "skynet_tower_connects_total", "Transitions to connected.", &WaterTower::Statistics::connects },
+        { "skynet_tower_disconnects_total", "Transitions to disconnected.", &WaterTower::Statistics::disconnects },
+        { "skynet_tower_alarms_total", "High water level alarms raised.", &WaterTower::Statistics::alarms },
+    };
+
+    for (unsigned int c = 0; c < sizeof(counters) / sizeof(counters[0]); c++) {
+        family(out, counters[c].name, "counter", counters[c].help);
+        foreach (WaterTower *tower, towers) {
+            out << counters[c].name << "{tower=\"" << tower->getIdentity() << "\"} "
+                << (tower->statistics().*counters[c].member).load() << "\n";
+        }
+    }
+
+    family(out, "skynet_tower_enabled", "gauge", "Whether the tower is polled.");
+    foreach (WaterTower *tower, towers)
+        out << "skynet_tower_enabled{tower=\"" << tower->getIdentity() << "\"} " << int(tower->isEnabled()) << "\n";
+    family(out, "skynet_tower_level_centimetres", "gauge", "Last water level read.");
+    foreach (WaterTower *tower, towers)
+        out << "skynet_tower_level_centimetres{tower=\"" << tower->getIdentity() << "\"} " << tower->getWaterLevel() << "\n";
+    family(out, "skynet_tower_height_centimetres", "gauge", "Height covered by the level sensors.");
+    foreach (WaterTower *tower, towers)
+        out << "skynet_tower_height_centimetres{tower=\"" << tower->getIdentity() << "\"} " << tower->getHeight() << "\n";
+    family(out, "skynet_tower_connected", "gauge", "Whether the tower answers polls.");
+    foreach (WaterTower *tower, towers)
+        out << "skynet_tower_connected{tower=\"" << tower->getIdentity() << "\"} " << int(tower->isDeviceConnected()) << "\n";
+}
+
+void MetricsServer::writeAlarms(QTextStream &out) const
+{
+    const NotifyPanel::Statistics &stats = NotifyPanel::instance()->statistics();
+
+    family(out, "skynet_alarms_raised_total", "counter", "Notifications raised.");
+    out << "skynet_alarms_raised_total " << stats.raised.load() << "\n";
+    family(out, "skynet_alarms_updated_total", "counter", "Repeated notifications from a source already queued.");
+    out << "skynet_alarms_updated_total " << stats.updated.load() << "\n";
+    family(out, "skynet_alarms_acknowledged_total", "counter", "Notifications confirmed on the panel.");
+    out << "skynet_alarms_acknowledged_total " << stats.acknowledged.load() << "\n";
+    family(out, "skynet_alarms_dropped_total", "counter", "Notifications evicted from a full queue.");
+    out << "skynet_alarms_dropped_total " << stats.dropped.load() << "\n";
+    family(out, "skynet_alarms_pending", "gauge", "Notifications queued or shown.");
+    out << "skynet_alarms_pending " << stats.pending.load() << "\n";
+}
+
+void MetricsServer::writeEventLoop(QTextStream &out) const
+{
+    EventLoopMonitor *monitor = EventLoopMonitor::instance();
+    QVector<quint32> histogram = monitor->histogram();
+
+    family(out, "skynet_event_loop_lag_seconds", "histogram", "Dispatch lag of a 100 ms GUI thread timer.");
+    quint64 cumulative = 0;
+    for (int i = 0; i < EventLoopMonitor::Buckets - 1; i++) {
+        cumulative += histogram.at(i);
+        out << "skynet_event_loop_lag_seconds_bucket{le=\"" << (1 << i) / 1000.0 << "\"} " << cumulative << "\n";
+    }
+    cumulative += histogram.at(EventLoopMonitor::Buckets - 1);
+    out << "skynet_event_loop_lag_seconds_bucket{le=\"+Inf\"} " << cumulative << "\n"
+        << "skynet_event_loop_lag_seconds_sum " << monitor->totalLag() / 1000.0 << "\n"
+        << "skynet_event_loop_lag_seconds_count " << cumulative << "\n";
+    family(out, "skynet_event_loop_stalls_total", "counter", "GUI thread dispatches longer than the stall threshold.");
+    out << "skynet_event_loop_stalls_total " << monitor->stallCount() << "\n";
+}
+
+void MetricsServer::writeAudio(QTextStream &out) const
+{
+    AudioStream *stream = AudioStream::instance();
+    const JitterBuffer::Statistics &stats = stream->statistics();
+
+    struct Counter {
+        const char *name;
+        const char *help;
+        QAtomicInt JitterBuffer::Statistics::*member;
+    };
+    static const Counter counters[] = {
+        { "skynet_audio_frames_received_total", "Baby-care audio frames received.", &JitterBuffer::Statistics::received },
+        { "skynet_audio_frames_lost_total", "Frames missing when they were due.", &JitterBuffer::Statistics::lost },
+        { "skynet_audio_frames_late_total", "Frames arriving after they were due.", &JitterBuffer::Statistics::late },
+        { "skynet_audio_frames_duplicate_total", "Frames received twice.", &JitterBuffer::Statistics::duplicates },
+        { "skynet_audio_frames_concealed_total", "Frames played from the loss concealment.", &JitterBuffer::Statistics::concealed },
+        { "skynet_audio_frames_discarded_total", "Frames dropped to bring the delay down.", &JitterBuffer::Statistics::discarded },
+        { "skynet_audio_underruns_total", "Jitter buffer ran dry.", &JitterBuffer::Statistics::underruns }
+    };
+
+    for (unsigned i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+        family(out, counters[i].name, "counter", counters[i].help);
+        out << counters[i].name << " " << (stats.*counters[i].member).load() << "\n";
+    }
+
+    family(out, "skynet_audio_streaming", "gauge", "1 while a baby-care stream is played.");
+    out << "skynet_audio_streaming " << (stream->isStreaming() ? 1 : 0) << "\n";
+    family(out, "skynet_audio_buffer_seconds", "gauge", "Audio held in the jitter buffer.");
+    out << "skynet_audio_buffer_seconds " << stats.depth.load() * JitterBuffer::FrameDuration / 1000000.0 << "\n";
+    family(out, "skynet_audio_buffer_target_seconds", "gauge", "Jitter buffer depth aimed at.");
+    out << "skynet_audio_buffer_target_seconds " << stats.target.load() * JitterBuffer::FrameDuration / 1000000.0 << "\n";
+    family(out, "skynet_audio_jitter_seconds", "gauge", "Interarrival jitter estimate.");
+    out << "skynet_audio_jitter_seconds " << stats.jitter.load() / 1000000.0 << "\n";
+    family(out, "skynet_audio_latency_seconds", "gauge", "Jitter buffer plus audio output buffer.");
+    out << "skynet_audio_latency_seconds " << stream->latency() / 1000.0 << "\n";
+}
+
+void MetricsServer::writeMemory(QTextStream &out) const
+{
+    /* size and resident set, in pages */
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return;
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    qint64 pageSize = sysconf(_SC_PAGESIZE);
+
+    family(out, "skynet_virtual_memory_bytes", "gauge", "Virtual memory size.");
+    out << "skynet_virtual_memory_bytes " << fields.value(0).toLongLong() * pageSize << "\n";
+    family(out, "skynet_resident_memory_bytes", "gauge", "Resident set size.");
+    out << "skynet_resident_memory_bytes " << fields.value(1).toLongLong() * pageSize << "\n";
+}
@@ -0,0 +1,53 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QHash>
+
+class QTcpServer;
+class QLocalServer;
+class QIODevice;
+class QTextStream;
+
+/*
+ * Serves the counters kept by MultiPointCom, WaterTower, NotifyPanel,
+ * EventLoopMonitor and AudioStream in the Prometheus text format, over plain
+ * HTTP on a TCP port and optionally on a Unix socket. Every request is
+ * answered with the full exposition and the connection is closed.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static MetricsServer *instance();
+
+    QByteArray exposition() const;
+
+private slots:
+    void newTcpConnection();
+    void newLocalConnection();
+    void readRequest();
+    void clientClosed();
+
+private:
+    explicit MetricsServer(QObject *parent = 0);
+    Q_DISABLE_COPY(MetricsServer)
+    void accept(QIODevice *client);
+    void writeRadio(QTextStream &out) const;
+    void writeLanes(QTextStream &out) const;
+    void writeTowers(QTextStream &out) const;
+    void writeAlarms(QTextStream &out) const;
+    void writeEventLoop(QTextStream &out) const;
+    void writeAudio(QTextStream &out) const;
+    void writeMemory(QTextStream &out) const;
+
+private:
+    static MetricsServer *self;
+
+    QTcpServer *tcpServer;
+    QLocalServer *localServer;
+    QHash<QIODevice *, QByteArray> requests;    /*  partial request headers by client  */
+};
+
+#endif // METRICSSERVER_H
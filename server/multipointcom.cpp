@@ -25,9 +25,11 @@
 
 #include <QFile>
 #include <QTime>
+#include <QElapsedTimer>
 #include <QUdpSocket>
 #include <QDebug>
 
+#include "watchdog.h"
 #include "multipointcom.h"
 
 
@@ -53,11 +55,28 @@ struct si4432_ioc_transfer {
 static const char *si4432Dev = "/dev/si4432";
 #endif
 
+/* a single transfer taking longer than this means the driver is wedged */
+static const int RadioDeadline = 5000;
+
+/*  measured in the unit of "millisecond"  */
+static const int ReceiveTimeout = 100;
+static const int PreemptSlice = 10;     /*  how often a background transfer looks for waiters  */
+
+static const char *laneName[MultiPointCom::Lanes] = { "urgent", "interactive", "background" };
+
 QMutex MultiPointCom::mutex;
+QWaitCondition MultiPointCom::radioFree;
+bool MultiPointCom::radioBusy = false;
+MultiPointCom::Priority MultiPointCom::holder = MultiPointCom::Interactive;
+quint32 MultiPointCom::nextTicket[MultiPointCom::Lanes] = { 0, 0, 0 };
+quint32 MultiPointCom::serving[MultiPointCom::Lanes] = { 0, 0, 0 };
+QAtomicInt MultiPointCom::preemptRequest;
 bool MultiPointCom::deviceInitialized = false;
 QTime MultiPointCom::lastConnectTime = QTime::currentTime();
 quint32 MultiPointCom::disconnectCount = 1;
 int MultiPointCom::device = -1;
+MultiPointCom::Statistics MultiPointCom::stats;
+const int MultiPointCom::rttBound[MultiPointCom::RttBuckets - 1] = { 5, 10, 25, 50, 100, 250, 1000 };
 
 const char *irqGPIO = "/sys/devices/virtual/gpio/gpio134/value";
 const char *sdnGPIO = "/sys/devices/virtual/gpio/gpio135/value";
@@ -65,6 +84,7 @@ const char *sdnGPIO = "/sys/devices/virtual/gpio/gpio135/value";
 MultiPointCom::MultiPointCom(QObject *parent) :
     QThread(parent),
     address(0x7F),
+    priority(Interactive),
     disconnect(0)
 {
 
@@ -97,19 +117,75 @@ bool MultiPointCom::sendRequest(char protocol, const QByteArray &data)
     request.append(protocol);
     request.append(data);
 
-    start();
+    start(priority == Urgent ? TimeCriticalPriority : InheritPriority);
 
     return true;
 }
 
-void MultiPointCom::run()
+/* static */
+const char *MultiPointCom::priorityName(Priority lane)
+{
+    return laneName[lane];
+}
+
+/* static, called with the mutex held */
+bool MultiPointCom::queuedAbove(Priority lane)
+{
+    for (int i = 0; i < lane; i++) {
+        if (nextTicket[i] != serving[i])
+            return true;
+    }
+    return false;
+}
+
+void MultiPointCom::acquire()
+{
+    QElapsedTimer wait;
+    wait.start();
+
+    stats.waiting.ref();
+    mutex.lock();
+    quint32 ticket = nextTicket[priority]++;
+    if (radioBusy && holder == Background && priority != Background)
+        preemptRequest.store(1);
+    while (radioBusy || serving[priority] != ticket || queuedAbove(priority))
+        radioFree.wait(&mutex);
+    serving[priority]++;
+    radioBusy = true;
+    holder = priority;
+    preemptRequest.store(0);
+    mutex.unlock();
+    stats.waiting.deref();
+
+    LaneStatistics &lane = stats.lanes[priority];
+    int msec = wait.elapsed();
+    lane.requests.ref();
+    record(lane.waitBuckets, lane.waitSum, msec);
+    if (priority == Urgent && msec > UrgentBound) {
+        lane.overruns.ref();
+        qDebug() << "Urgent transfer queued for" << msec << "ms";
+    }
+}
+
+void MultiPointCom::release()
 {
     mutex.lock();
+    radioBusy = false;
+    radioFree.wakeAll();
+    mutex.unlock();
+}
+
+void MultiPointCom::run()
+{
+    acquire();
+    Watchdog::instance()->checkIn("radio", RadioDeadline);
+    stats.requests.ref();
 
     QTime timeout = lastConnectTime.addSecs(30);
 
     if (timeout < QTime::currentTime()) {
         qDebug() << "Device connected timeout" << disconnectCount++;
+        stats.resets.ref();
         lastConnectTime = QTime::currentTime();
 #ifdef __arm__
         ioctl(device, SI4432_IOC_RESET, 1);
@@ -124,18 +200,24 @@ void MultiPointCom::run()
     tr.tx_buf = (__u64)txBuf;
     tr.rx_buf = (__u64)rxBuf;
     tr.len = request.size();
+    QElapsedTimer rtt;
+    rtt.start();
     int len = ioctl(device, SI4432_IOC_MESSAGE(1), &tr);
     if (len > 0) {
         response.clear();
         response.append(rxBuf, len);
         quint8 addr = response.at(0);
         if (addr == address) {
+            recordRtt(rtt.elapsed());
             lastConnectTime = QTime::currentTime();
             disconnect = 0;
             emit deviceConnected();
             emit responseReceived(response.at(1), QByteArray(response.data() + 2, len - 2));
+        } else {
+            stats.lost.ref();
         }
     } else {
+        stats.lost.ref();
         disconnect++;
         if (disconnect > 3) {
             disconnect = 0;
@@ -143,20 +225,38 @@ void MultiPointCom::run()
         }
     }
 #else
+    /* the driver ioctl above blocks, only this path can give the radio up early */
     QUdpSocket *udp = new QUdpSocket();
+    QElapsedTimer rtt;
+    rtt.start();
     udp->writeDatagram(request, QHostAddress::LocalHost, 19999);
 
-    if (udp->waitForReadyRead(100) && (udp->pendingDatagramSize() > 0)) {
+    int slice = priority == Background ? PreemptSlice : ReceiveTimeout;
+    bool ready = false;
+    bool preempted = false;
+    while (!ready && !preempted && rtt.elapsed() < ReceiveTimeout) {
+        ready = udp->waitForReadyRead(qMin(slice, ReceiveTimeout - int(rtt.elapsed())));
+        preempted = !ready && priority == Background && preemptRequest.load();
+    }
+
+    if (preempted) {
+        /* not the tower's fault, the next sweep asks again */
+        stats.lanes[priority].preempted.ref();
+    } else if (ready && (udp->pendingDatagramSize() > 0)) {
         response.resize(udp->pendingDatagramSize());
         udp->readDatagram(response.data(), response.size());
         quint8 addr = response.at(0);
         if (addr == address) {
+            recordRtt(rtt.elapsed());
             lastConnectTime = QTime::currentTime();
             disconnect = 0;
             emit deviceConnected();
             emit responseReceived(response.at(1), response.mid(2));
+        } else {
+            stats.lost.ref();
         }
     } else {
+        stats.lost.ref();
         disconnect++;
         if (disconnect > 3) {
             disconnect = 0;
@@ -166,5 +266,25 @@ void MultiPointCom::run()
     delete udp;
 #endif
 
-    mutex.unlock();
+    Watchdog::instance()->release("radio");
+    release();
+}
+
+/* static */
+void MultiPointCom::record(QAtomicInt *buckets, QAtomicInteger<qint64> &sum, int msec)
+{
+    sum.fetchAndAddRelaxed(msec);
+
+    int bucket = 0;
+    while (bucket < RttBuckets - 1 && msec > rttBound[bucket])
+        bucket++;
+    buckets[bucket].ref();
+}
+
+void MultiPointCom::recordRtt(int msec)
+{
+    LaneStatistics &lane = stats.lanes[priority];
+    stats.responses.ref();
+    record(stats.rttBuckets, stats.rttSum, msec);
+    record(lane.rttBuckets, lane.rttSum, msec);
 }
@@ -3,7 +3,19 @@
 
 #include <QThread>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QAtomicInteger>
 
+/*
+ * One transfer on the shared SI4432 radio, run on its own thread.
+ *
+ * Transfers queue for the radio in priority lanes, FIFO within a lane and a
+ * lower lane only served once every higher one is empty. A background
+ * transfer waiting for its reply gives the radio up as soon as anything else
+ * queues, so an urgent frame only waits behind the urgent frames queued
+ * before it and at most one interactive transfer in flight.
+ */
 class MultiPointCom : public QThread
 {
     Q_OBJECT
@@ -16,6 +28,46 @@ public:
         ReceiveTimeout
     };
 
+    enum Priority {
+        Urgent,             /*  motion, panic buttons  */
+        Interactive,        /*  the default, a request somebody waits for  */
+        Background,         /*  periodic sweeps, preempted by the lanes above  */
+        Lanes
+    };
+
+    /* bucket i counts round trips up to rttBound[i], the last one the rest */
+    static const int RttBuckets = 8;
+    static const int rttBound[RttBuckets - 1];
+
+    /*  per lane, times measured in the unit of "millisecond"  */
+    struct LaneStatistics {
+        QAtomicInt requests;
+        QAtomicInt preempted;       /*  reply wait cut short for a higher lane  */
+        QAtomicInt overruns;        /*  urgent transfers queued longer than UrgentBound  */
+        QAtomicInteger<qint64> waitSum;     /*  queued for the radio, 64 bit so the sums never wrap  */
+        QAtomicInt waitBuckets[RttBuckets];
+        QAtomicInteger<qint64> rttSum;
+        QAtomicInt rttBuckets[RttBuckets];
+    };
+
+    /*
+     * Updated lock free from the transfer threads, read by MetricsServer.
+     * Round trip times are measured in the unit of "millisecond".
+     */
+    struct Statistics {
+        QAtomicInt requests;
+        QAtomicInt responses;
+        QAtomicInt lost;            /*  no reply, or a reply from another address  */
+        QAtomicInt resets;          /*  radio reset after 30 s without any reply  */
+        QAtomicInt waiting;         /*  transfers queued on the radio right now  */
+        QAtomicInteger<qint64> rttSum;
+        QAtomicInt rttBuckets[RttBuckets];
+        LaneStatistics lanes[Lanes];
+    };
+
+    /*  worst case queueing for an urgent transfer, measured in the unit of "millisecond"  */
+    static const int UrgentBound = 150;
+
     MultiPointCom(QObject *parent = 0);
     ~MultiPointCom();
 
@@ -24,8 +76,20 @@ public:
         address = addr;
     }
 
+    void setPriority(Priority lane)
+    {
+        priority = lane;
+    }
+
+    static const char *priorityName(Priority lane);
+
     bool sendRequest(char protocol, const QByteArray &data);
 
+    static const Statistics &statistics()
+    {
+        return stats;
+    }
+
 signals:
     void responseReceived(char protocol, const QByteArray &data);
     void deviceConnected();
@@ -35,16 +99,31 @@ signals:
 protected:
     virtual void run();
 
+private:
+    void acquire();
+    void release();
+    static bool queuedAbove(Priority lane);
+    static void record(QAtomicInt *buckets, QAtomicInteger<qint64> &sum, int msec);
+    void recordRtt(int msec);
+
 private:
     quint8 address;
+    Priority priority;
     QByteArray request;
     QByteArray response;
     int disconnect;
-    static QMutex mutex;
+    static QMutex mutex;            /*  guards the lane state below  */
+    static QWaitCondition radioFree;
+    static bool radioBusy;
+    static Priority holder;
+    static quint32 nextTicket[Lanes];
+    static quint32 serving[Lanes];
+    static QAtomicInt preemptRequest;
     static bool deviceInitialized;
     static QTime lastConnectTime;
     static quint32 disconnectCount;
     static int device;
+    static Statistics stats;
 };
 
 #endif // MULTIPOINTCOM_H
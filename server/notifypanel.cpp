@@ -3,15 +3,17 @@
 #include <QVBoxLayout>
 #include <QSpacerItem>
 #include <QDialogButtonBox>
+#include <QPushButton>
 #include <QLabel>
 #include <QUuid>
-#include <QMediaPlayer>
 #include <QDir>
 #include <QTimer>
 #include <QDebug>
 
+#include "alarmjournal.h"
 #include "avatarwidget.h"
 #include "notifypanel.h"
+#include "pcmplayer.h"
 #include "settings.h"
 #include "hal.h"
 
@@ -38,33 +40,36 @@ NotifyPanel::NotifyPanel(QWidget *parent) :
 
     QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok, this);
     connect(buttons, SIGNAL(accepted()), this, SLOT(confirm()));
+    QPushButton *snoozeButton = buttons->addButton(tr("Snooze"), QDialogButtonBox::ActionRole);
+    connect(snoozeButton, SIGNAL(clicked()), this, SLOT(snooze()));
     vLayout->addWidget(buttons);
 
     blinkIntervalMap[Low] = 3000;
     blinkIntervalMap[Middle] = 2000;
     blinkIntervalMap[High] = 1000;
 
+    ledMap[Low] = Hal::BlueLed;
+    ledMap[Middle] = Hal::YellowLed;
+    ledMap[High] = Hal::RedLed;
+
     isOn = false;
+    kernelBlink = false;
     timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), this, SLOT(blink()));
 
     ledsOff();
+    connect(Hal::instance(), SIGNAL(powerChanged(bool)), this, SLOT(powerChanged(bool)));
 
-    mediaMap[Low] = QString("%1/audios/%2.mp3").arg(qApp->applicationDirPath()).arg(QLatin1String("low"));
-    mediaMap[Middle] = QString("%1/audios/%2.mp3").arg(qApp->applicationDirPath()).arg(QLatin1String("middle"));
-    mediaMap[High] = QString("%1/audios/%2.mp3").arg(qApp->applicationDirPath()).arg(QLatin1String("high"));
+    clipMap[Low] = QLatin1String("low");
+    clipMap[Middle] = QLatin1String("middle");
+    clipMap[High] = QLatin1String("high");
 
-    player = new QMediaPlayer(this);
+    player = new PcmPlayer(this);
     player->setVolume(Settings::instance()->getVolume());
     connect(Settings::instance(), SIGNAL(volumeChanged(int)), player, SLOT(setVolume(int)));
 
-    playlist = new QMediaPlaylist(player);
-    playlist->setPlaybackMode(QMediaPlaylist::CurrentItemInLoop);
-    playlist->addMedia(QUrl::fromLocalFile(mediaMap[Low]));
-    playlist->addMedia(QUrl::fromLocalFile(mediaMap[Middle]));
-    playlist->addMedia(QUrl::fromLocalFile(mediaMap[High]));
-
-    player->setPlaylist(playlist);
+    /* alarms still unacknowledged when the unit went down */
+    QTimer::singleShot(0, this, SLOT(restore()));
 }
 
 QString NotifyPanel::uuid() const
@@ -72,39 +77,43 @@ QString NotifyPanel::uuid() const
     return QUuid::createUuid().toString();
 }
 
+/*
+ * Same uuid for the same source on every boot, so journaled alarms can be
+ * matched with new ones after a restart.
+ */
+QString NotifyPanel::uuid(const QString &source) const
+{
+    static const QUuid ns("{6a1d3c56-3f0e-4b7c-9a57-2d0f4c1b8e21}");
+    return QUuid::createUuidV5(ns, source).toString();
+}
+
 void NotifyPanel::addNotify(const QString &uuid, Priority priority, const QString &text, const QString &icon)
 {
     if (uuid == currentUuid) {
+        stats.updated.ref();
+        AlarmJournal::instance()->update(uuid, priority, text, icon);
         message->setText(text);
         avatar->setAvatar(QPixmap(icon));
         return;
     }
 
-    QList<QStringList> *notifies;
-    switch (priority) {
-    case Low:
-        notifies = &lowPriorityNotifies;
-        break;
-    case Middle:
-        notifies = &middlePriorityNotifies;
-        break;
-    case High:
-        notifies = &highPriorityNotifies;
-        break;
-    default:
-        notifies = 0;
-        break;
+    if (priority == None)
+        return;
+
+    QString evicted;
+    if (notifies.push(uuid, priority, text, icon, &evicted)) {
+        stats.raised.ref();
+        AlarmJournal::instance()->raise(uuid, priority, text, icon);
+    } else {
+        stats.updated.ref();
+        AlarmJournal::instance()->update(uuid, priority, text, icon);
     }
-    if (notifies && notifies->count() < 8) {
-        QListIterator<QStringList> i(*notifies);
-        while (i.hasNext()) {
-            const QStringList &notify = i.next();
-            notifies->removeOne(notify);
-        }
-        notifies->append(QStringList() << uuid << text << icon);
-        Hal::instance()->powerOn();
-        nextNotify();
+    if (!evicted.isEmpty()) {
+        stats.dropped.ref();
+        AlarmJournal::instance()->drop(evicted);
     }
+    Hal::instance()->powerOn();
+    nextNotify();
 }
 
 NotifyPanel *NotifyPanel::instance()
@@ -115,6 +124,27 @@ NotifyPanel *NotifyPanel::instance()
 }
 
 void NotifyPanel::confirm()
+{
+    if (!currentUuid.isEmpty()) {
+        stats.acknowledged.ref();
+        AlarmJournal::instance()->acknowledge(currentUuid);
+        emit acknowledged(currentUuid);
+    }
+    dismiss();
+}
+
+/* off the panel for now, AlarmController raises it again once the snooze is over */
+void NotifyPanel::snooze()
+{
+    if (!currentUuid.isEmpty()) {
+        AlarmJournal::instance()->drop(currentUuid);
+        emit snoozed(currentUuid);
+    }
+    dismiss();
+}
+
+/* on to the next notification, or close the panel */
+void NotifyPanel::dismiss()
 {
     currentUuid = "";
     nextNotify();
@@ -130,60 +160,95 @@ void NotifyPanel::blink()
 {
     isOn = !isOn;
 
-    switch (currentPriority) {
-    case Low:
-        Hal::instance()->setBlueLed(isOn);
-        break;
-    case Middle:
-        Hal::instance()->setYellowLed(isOn);
-        break;
-    case High:
-        Hal::instance()->setRedLed(isOn);
-        break;
-    default:
-        break;
-    }
+    if (ledMap.contains(currentPriority))
+        Hal::instance()->setOutput(ledMap[currentPriority], isOn);
 }
 
-void NotifyPanel::nextNotify()
+void NotifyPanel::restore()
 {
-    if(currentUuid.isEmpty()) {
-        if (!highPriorityNotifies.isEmpty()) {
-            showNotify(High, highPriorityNotifies.takeFirst());
-        } else if (!middlePriorityNotifies.isEmpty()) {
-            showNotify(Middle, middlePriorityNotifies.takeFirst());
-        } else if (!lowPriorityNotifies.isEmpty()) {
-            showNotify(Low, lowPriorityNotifies.takeFirst());
-        } else {
+    QList<AlarmJournal::Record> records = AlarmJournal::instance()->outstanding();
+    if (records.isEmpty())
+        return;
 
+    qDebug() << "Restoring" << records.count() << "unacknowledged alarm(s)";
+    foreach (const AlarmJournal::Record &record, records) {
+        QString evicted;
+        notifies.push(record.uuid, record.priority, record.text, record.icon, &evicted);
+        if (!evicted.isEmpty()) {
+            stats.dropped.ref();
+            AlarmJournal::instance()->drop(evicted);
         }
     }
+
+    Hal::instance()->powerOn();
+    nextNotify();
+}
+
+void NotifyPanel::powerChanged(bool on)
+{
+    if (currentPriority == None || kernelBlink)
+        return;
+
+    /* hold the alarm led steadily lit instead of waking up to blink it */
+    if (on) {
+        timer->start(blinkIntervalMap[currentPriority]);
+    } else {
+        timer->stop();
+        isOn = false;
+        blink();
+    }
+}
+
+void NotifyPanel::nextNotify()
+{
+    if (currentUuid.isEmpty() && !notifies.isEmpty())
+        showNotify(notifies.takeFirst());
+    else
+        countPending();
 }
 
-void NotifyPanel::showNotify(Priority priority, const QStringList &notify)
+void NotifyPanel::showNotify(const NotifyQueue::Entry &notify)
 {
+    Priority priority = Priority(notify.priority);
     if (currentPriority != priority) {
         currentPriority = priority;
         ledsOff();
-        timer->start(blinkIntervalMap[priority]);
-        player->stop();
-        playlist->setCurrentIndex(priority);
-        player->play();
+        startBlink();
+        player->play(clipMap[priority], true);
     }
 
-    currentUuid = notify[0];
-    message->setText(notify[1]);
-    avatar->setAvatar(QPixmap(notify[2]));
+    currentUuid = notify.uuid;
+    message->setText(notify.text);
+    avatar->setAvatar(QPixmap(notify.icon));
+    /* before exec(), which only returns once the panel is closed */
+    countPending();
     if (!isVisible()) {
         exec();
     }
 }
 
+void NotifyPanel::countPending()
+{
+    stats.pending.store(notifies.count() + (currentUuid.isEmpty() ? 0 : 1));
+}
+
+void NotifyPanel::startBlink()
+{
+    int interval = blinkIntervalMap[currentPriority];
+    kernelBlink = Hal::instance()->blinkLed(ledMap[currentPriority], interval, interval);
+    if (!kernelBlink && Hal::instance()->isPowerOn())
+        timer->start(interval);
+}
+
 void NotifyPanel::ledsOff()
 {
     timer->stop();
     isOn = false;
-    Hal::instance()->setBlueLed(isOn);
-    Hal::instance()->setYellowLed(isOn);
-    Hal::instance()->setRedLed(isOn);
+    kernelBlink = false;
+
+    QMap<Hal::Output, int> leds;
+    leds[Hal::BlueLed] = 0;
+    leds[Hal::YellowLed] = 0;
+    leds[Hal::RedLed] = 0;
+    Hal::instance()->setOutputs(leds);
 }
@@ -4,12 +4,15 @@
 #include <QDialog>
 #include <QStringList>
 #include <QMap>
-#include <QMediaPlayer>
-#include <QMediaPlaylist>
+#include <QAtomicInt>
+
+#include "notifyqueue.h"
+#include "hal.h"
 
 class QLabel;
 class QTimer;
 class AvatarWidget;
+class PcmPlayer;
 
 class NotifyPanel : public QDialog
 {
@@ -23,25 +26,48 @@ public:
         None
     };
     QString uuid() const;
+    QString uuid(const QString &source) const;
     void addNotify(const QString &uuid, Priority priority, const QString &text, const QString &icon = "");
     static NotifyPanel *instance();
 
+    /* lock free, read by MetricsServer */
+    struct Statistics {
+        QAtomicInt raised;
+        QAtomicInt updated;
+        QAtomicInt acknowledged;
+        QAtomicInt dropped;     /*  evicted from a full queue  */
+        QAtomicInt pending;     /*  queued plus the one shown  */
+    };
+
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+signals:
+    void acknowledged(const QString &uuid);
+    void snoozed(const QString &uuid);
+
 private slots:
     void confirm();
+    void snooze();
     void blink();
+    void restore();
+    void powerChanged(bool on);
 
 private:
     explicit NotifyPanel(QWidget *parent = 0);
     Q_DISABLE_COPY(NotifyPanel)
     void nextNotify();
-    void showNotify(Priority priority, const QStringList &notify);
+    void showNotify(const NotifyQueue::Entry &notify);
+    void startBlink();
     void ledsOff();
+    void countPending();
+    void dismiss();
 
 private:
     static NotifyPanel *self;
-    QList<QStringList> lowPriorityNotifies;
-    QList<QStringList> middlePriorityNotifies;
-    QList<QStringList> highPriorityNotifies;
+    NotifyQueue notifies;
 
     QString currentUuid;
     Priority currentPriority;
@@ -50,13 +76,16 @@ private:
     QLabel *message;
 
     QMap<Priority, int> blinkIntervalMap;
+    QMap<Priority, Hal::Output> ledMap;
 
     bool isOn;
+    bool kernelBlink;
     QTimer *timer;
 
-    QMap<Priority, QString> mediaMap;
-    QMediaPlayer *player;
-    QMediaPlaylist *playlist;
+    QMap<Priority, QString> clipMap;
+    PcmPlayer *player;
+
+    Statistics stats;
 };
 
 #endif // NOTIFYPANEL_H
@@ -0,0 +1,85 @@
+#include <QDebug>
+
+#include "notifyqueue.h"
+
+NotifyQueue::NotifyQueue(int capacity) :
+    sequence(0),
+    overflows(0),
+    limit(qMax(1, capacity))
+{
+}
+
+/*
+ * Returns true when a new entry was queued, or turned away by a full queue,
+ * false when an existing entry of the same source was updated.
+ */
+bool NotifyQueue::push(const QString &uuid, int priority, const QString &text, const QString &icon, QString *evicted)
+{
+    QHash<QString, Entry>::iterator i = entries.find(uuid);
+    if (i != entries.end()) {
+        if (i->priority != priority) {
+            order.remove(keyOf(*i));
+            i->priority = priority;
+            order.insert(keyOf(*i), uuid);
+        }
+        i->text = text;
+        i->icon = icon;
+        return false;
+    }
+
+    if (order.count() >= limit) {
+        /* the last key is the lowest priority; step back to its oldest entry */
+        QMap<Key, QString>::iterator last = order.end() - 1;
+        if (priority < -last.key().first) {
+            qDebug() << "Notify queue full, turning away" << uuid << "priority" << priority;
+            if (evicted)
+                *evicted = uuid;
+            overflows++;
+            return true;
+        }
+        QMap<Key, QString>::iterator victim = order.lowerBound(Key(last.key().first, 0));
+        qDebug() << "Notify queue full, dropping" << victim.value() << "priority" << -victim.key().first;
+        if (evicted)
+            *evicted = victim.value();
+        entries.remove(victim.value());
+        order.erase(victim);
+        overflows++;
+    }
+
+    Entry entry;
+    entry.uuid = uuid;
+    entry.priority = priority;
+    entry.sequence = sequence++;
+    entry.text = text;
+    entry.icon = icon;
+    entries.insert(uuid, entry);
+    order.insert(keyOf(entry), uuid);
+    return true;
+}
+
+NotifyQueue::Entry NotifyQueue::takeFirst()
+{
+    QMap<Key, QString>::iterator first = order.begin();
+    Entry entry = entries.take(first.value());
+    order.erase(first);
+    return entry;
+}
+
+bool NotifyQueue::remove(const QString &uuid)
+{
+    QHash<QString, Entry>::iterator i = entries.find(uuid);
+    if (i == entries.end())
+        return false;
+
+    order.remove(keyOf(*i));
+    entries.erase(i);
+    return true;
+}
+
+QList<NotifyQueue::Entry> NotifyQueue::toList() const
+{
+    QList<Entry> list;
+    foreach (const QString &uuid, order)
+        list.append(entries.value(uuid));
+    return list;
+}
@@ -0,0 +1,78 @@
+#ifndef NOTIFYQUEUE_H
+#define NOTIFYQUEUE_H
+
+#include <QString>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+
+/*
+ * Pending notifications, one per source uuid, ordered by priority and then
+ * by the time the source first raised it.
+ *
+ * A repeated notification from the same source updates its entry in place.
+ * When the queue is full the lowest priority, oldest entry is evicted for a
+ * new one of at least that priority. A new entry of lower priority than any
+ * queued is turned away instead, and reported as the evicted one.
+ */
+class NotifyQueue
+{
+public:
+    struct Entry {
+        QString uuid;
+        int priority;
+        quint64 sequence;
+        QString text;
+        QString icon;
+    };
+
+    explicit NotifyQueue(int capacity = 64);
+
+    bool isEmpty() const
+    {
+        return order.isEmpty();
+    }
+
+    int count() const
+    {
+        return order.count();
+    }
+
+    int capacity() const
+    {
+        return limit;
+    }
+
+    quint64 overflowCount() const
+    {
+        return overflows;
+    }
+
+    bool contains(const QString &uuid) const
+    {
+        return entries.contains(uuid);
+    }
+
+    bool push(const QString &uuid, int priority, const QString &text, const QString &icon, QString *evicted = 0);
+    Entry takeFirst();
+    bool remove(const QString &uuid);
+    QList<Entry> toList() const;
+
+private:
+    /* higher priority first, then older first */
+    typedef QPair<int, quint64> Key;
+
+    static Key keyOf(const Entry &entry)
+    {
+        return Key(-entry.priority, entry.sequence);
+    }
+
+private:
+    QHash<QString, Entry> entries;
+    QMap<Key, QString> order;
+    quint64 sequence;
+    quint64 overflows;
+    int limit;
+};
+
+#endif // NOTIFYQUEUE_H
@@ -0,0 +1,224 @@
+#include <QAudioOutput>
+#include <QIODevice>
+#include <QDebug>
+
+#include "audioclips.h"
+#include "audiostream.h"
+#include "pcmplayer.h"
+
+/* enough to ride out a busy GUI thread, short enough for a quick onset */
+static const int BufferDuration = 40000;    /*  measured in the unit of "microsecond"  */
+
+class ClipDevice : public QIODevice
+{
+public:
+    explicit ClipDevice(QObject *parent = 0) :
+        QIODevice(parent),
+        position(0),
+        loop(false)
+    {
+    }
+
+    void setClip(const QByteArray &data, bool loop)
+    {
+        pcm = data;
+        position = 0;
+        this->loop = loop;
+    }
+
+    qreal progress() const
+    {
+        return pcm.isEmpty() ? 0 : qreal(position) / pcm.size();
+    }
+
+    bool isSequential() const
+    {
+        return true;
+    }
+
+    qint64 bytesAvailable() const
+    {
+        if (loop && !pcm.isEmpty())
+            return pcm.size() + QIODevice::bytesAvailable();
+        return pcm.size() - position + QIODevice::bytesAvailable();
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize)
+    {
+        qint64 total = 0;
+        while (total < maxSize && !pcm.isEmpty()) {
+            if (position >= pcm.size()) {
+                if (!loop)
+                    break;
+                position = 0;
+            }
+            qint64 chunk = qMin(maxSize - total, qint64(pcm.size() - position));
+            memcpy(data + total, pcm.constData() + position, chunk);
+            position += chunk;
+            total += chunk;
+        }
+        return total;
+    }
+
+    qint64 writeData(const char *data, qint64 maxSize)
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+private:
+    QByteArray pcm;
+    int position;
+    bool loop;
+};
+
+PcmPlayer::PcmPlayer(QObject *parent) :
+    QObject(parent),
+    output(0),
+    loop(false),
+    waiting(false),
+    holding(false),
+    volume(1.0)
+{
+    device = new ClipDevice(this);
+    device->open(QIODevice::ReadOnly);
+    connect(AudioClips::instance(), SIGNAL(ready(QString)), this, SLOT(clipReady(QString)));
+    connect(AudioClips::instance(), SIGNAL(failed(QString)), this, SLOT(clipFailed(QString)));
+}
+
+void PcmPlayer::play(const QString &name, bool loop)
+{
+    clip = name;
+    this->loop = loop;
+    waiting = true;
+    resolve();
+}
+
+void PcmPlayer::stop()
+{
+    waiting = false;
+    loop = false;
+    if (output)
+        output->stop();
+    release();
+}
+
+bool PcmPlayer::isPlaying() const
+{
+    return waiting || (output && output->state() == QAudio::ActiveState);
+}
+
+qreal PcmPlayer::progress() const
+{
+    return device->progress();
+}
+
+void PcmPlayer::setVolume(int value)
+{
+    volume = qBound(0, value, 100) / 100.0;
+    if (output)
+        output->setVolume(volume);
+}
+
+void PcmPlayer::clipReady(const QString &name)
+{
+    Q_UNUSED(name);
+    if (waiting)
+        resolve();
+}
+
+void PcmPlayer::clipFailed(const QString &name)
+{
+    Q_UNUSED(name);
+    if (waiting)
+        resolve();
+}
+
+/*
+ * Starts the clip once decoded, still being decoded right after boot it
+ * starts as soon as it is. One that failed falls back to another clip, and
+ * with none to fall back to the player gives up instead of waiting forever.
+ */
+void PcmPlayer::resolve()
+{
+    AudioClips *clips = AudioClips::instance();
+    if (clips->isReady(clip)) {
+        start();
+        return;
+    }
+    if (!clips->hasFailed(clip))
+        return;
+
+    QString other = clips->fallback();
+    if (!other.isEmpty()) {
+        qDebug() << "Audio clip" << clip << "failed, playing" << other << "instead";
+        clip = other;
+        start();
+    } else if (!clips->isDecoding()) {
+        qDebug() << "Audio clip" << clip << "failed, nothing to play instead";
+        waiting = false;
+        emit finished();
+    }
+}
+
+void PcmPlayer::stateChanged(QAudio::State state)
+{
+    if (state != QAudio::IdleState)
+        return;
+
+    /* a loop never runs dry, nor a clip not played to the end: the buffer did */
+    if (loop || device->progress() < 1) {
+        QMetaObject::invokeMethod(this, "restart", Qt::QueuedConnection);
+        return;
+    }
+
+    /* a one shot clip ran dry */
+    output->stop();
+    release();
+    emit finished();
+}
+
+/*
+ * Goes on where the buffer ran dry, unless the backend resumed by itself or
+ * the player was stopped meanwhile.
+ */
+void PcmPlayer::restart()
+{
+    if (output && output->state() == QAudio::IdleState && (loop || device->progress() < 1)) {
+        output->stop();
+        output->start(device);
+    }
+}
+
+void PcmPlayer::start()
+{
+    waiting = false;
+    if (!holding) {
+        holding = true;
+        AudioStream::holdOutput(true);
+    }
+
+    QAudioFormat format = AudioClips::instance()->format(clip);
+    if (!output || outputFormat != format) {
+        delete output;
+        outputFormat = format;
+        output = new QAudioOutput(format, this);
+        output->setBufferSize(format.bytesForDuration(BufferDuration));
+        output->setVolume(volume);
+        connect(output, SIGNAL(stateChanged(QAudio::State)), this, SLOT(stateChanged(QAudio::State)));
+    }
+
+    output->stop();
+    device->setClip(AudioClips::instance()->pcm(clip), loop);
+    output->start(device);
+}
+
+void PcmPlayer::release()
+{
+    if (holding) {
+        holding = false;
+        AudioStream::holdOutput(false);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef PCMPLAYER_H
+#define PCMPLAYER_H
+
+#include <QObject>
+#include <QAudio>
+#include <QAudioFormat>
+
+class QAudioOutput;
+class ClipDevice;
+
+/*
+ * Plays clips decoded by AudioClips straight to the audio device through a
+ * short buffer, optionally looping them without a gap. A clip that can not
+ * be decoded is replaced by the most urgent one that could. While playing
+ * the player holds the audio device, an AudioStream gives way to it.
+ */
+class PcmPlayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PcmPlayer(QObject *parent = 0);
+
+    void play(const QString &name, bool loop);
+    void stop();
+    bool isPlaying() const;
+    qreal progress() const;
+
+signals:
+    void finished();
+
+public slots:
+    void setVolume(int value);
+
+private slots:
+    void clipReady(const QString &name);
+    void clipFailed(const QString &name);
+    void stateChanged(QAudio::State state);
+    void restart();
+
+private:
+    void resolve();
+    void start();
+    void release();
+
+private:
+    QAudioOutput *output;
+    QAudioFormat outputFormat;
+    ClipDevice *device;
+
+    QString clip;
+    bool loop;
+    bool waiting;
+    bool holding;           /*  the audio device, see AudioStream::holdOutput()  */
+    qreal volume;
+};
+
+#endif // PCMPLAYER_H
@@ -0,0 +1,117 @@
+#include <QTimer>
+#include <QDebug>
+
+#include "settings.h"
+#include "hal.h"
+#include "powermanager.h"
+
+PowerManager *PowerManager::self = 0;
+
+static const int CheckInterval = 1000;
+static const int DimLead = 30 * 1000;       /*  dim this long before switching off  */
+static const int DimFade = 500;
+static const int OffFade = 1000;
+static const int WakeFade = 200;
+
+PowerManager::PowerManager(QObject *parent) :
+    QObject(parent),
+    lastActivity(0),
+    current(Active)
+{
+    clock.start();
+
+    setIdleTime(Settings::instance()->getIdleTime());
+    quietFrom = Settings::instance()->getIdleTimeFrom();
+    quietTo = Settings::instance()->getIdleTimeTo();
+    connect(Settings::instance(), SIGNAL(idleTimeChanged(int)), this, SLOT(setIdleTime(int)));
+    connect(Settings::instance(), SIGNAL(idleTimeFromChanged(QTime)), this, SLOT(setQuietFrom(QTime)));
+    connect(Settings::instance(), SIGNAL(idleTimeToChanged(QTime)), this, SLOT(setQuietTo(QTime)));
+    connect(Hal::instance(), SIGNAL(powerChanged(bool)), this, SLOT(powerChanged(bool)));
+
+    timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(check()));
+    timer->start(CheckInterval);
+}
+
+PowerManager *PowerManager::instance()
+{
+    if (!self)
+        self = new PowerManager();
+    return self;
+}
+
+/*
+ * [from, to), wrapping over midnight when to is earlier than from; an empty
+ * window when both are equal.
+ */
+bool PowerManager::isQuietTime(const QTime &time) const
+{
+    if (quietFrom < quietTo)
+        return time >= quietFrom && time < quietTo;
+    if (quietTo < quietFrom)
+        return time >= quietFrom || time < quietTo;
+    return false;
+}
+
+void PowerManager::check()
+{
+    if (current == Off)
+        return;
+
+    qint64 idle = idleMsec();
+    if (idle < idleTime - DimLead || !isQuietTime(QTime::currentTime())) {
+        if (current != Active)
+            wake();
+        return;
+    }
+
+    if (idle >= idleTime) {
+        setState(Off);
+        Hal::instance()->powerOff(OffFade);
+    } else if (current == Active) {
+        setState(Dimmed);
+        Hal::instance()->fadeBrightness(qMax(1, Settings::instance()->getBrightness() / 2), DimFade);
+    }
+}
+
+void PowerManager::setIdleTime(int minutes)
+{
+    idleTime = qint64(minutes) * 60 * 1000;
+}
+
+void PowerManager::setQuietFrom(const QTime &time)
+{
+    quietFrom = time;
+}
+
+void PowerManager::setQuietTo(const QTime &time)
+{
+    quietTo = time;
+}
+
+void PowerManager::powerChanged(bool on)
+{
+    /* power key, alarms and ourselves all go through Hal */
+    if (on) {
+        lastActivity = clock.elapsed();
+        setState(Active);
+        timer->start(CheckInterval);
+    } else {
+        setState(Off);
+        timer->stop();
+    }
+}
+
+void PowerManager::wake()
+{
+    setState(Active);
+    Hal::instance()->fadeBrightness(Settings::instance()->getBrightness(), WakeFade);
+}
+
+void PowerManager::setState(State state)
+{
+    if (current != state) {
+        current = state;
+        emit stateChanged(state);
+    }
+}
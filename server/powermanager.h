@@ -0,0 +1,78 @@
+#ifndef POWERMANAGER_H
+#define POWERMANAGER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTime>
+
+class QTimer;
+
+/*
+ * Display power policy.
+ *
+ * Input only stores a monotonic timestamp. A single coarse timer compares it
+ * against the idle time and, within the quiet hours, dims the backlight and
+ * later fades it out through Hal.
+ */
+class PowerManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State {
+        Active,
+        Dimmed,
+        Off
+    };
+
+    static PowerManager *instance();
+
+    State state() const
+    {
+        return current;
+    }
+
+    void touch()
+    {
+        lastActivity = clock.elapsed();
+        if (current == Dimmed)
+            wake();
+    }
+
+    qint64 idleMsec() const
+    {
+        return clock.elapsed() - lastActivity;
+    }
+
+    bool isQuietTime(const QTime &time) const;
+
+signals:
+    void stateChanged(PowerManager::State state);
+
+private slots:
+    void check();
+    void setIdleTime(int minutes);
+    void setQuietFrom(const QTime &time);
+    void setQuietTo(const QTime &time);
+    void powerChanged(bool on);
+
+private:
+    explicit PowerManager(QObject *parent = 0);
+    Q_DISABLE_COPY(PowerManager)
+    void wake();
+    void setState(State state);
+
+private:
+    static PowerManager *self;
+
+    QElapsedTimer clock;
+    qint64 lastActivity;
+    QTimer *timer;
+    State current;
+
+    qint64 idleTime;        /*  measured in the unit of "millisecond"  */
+    QTime quietFrom;
+    QTime quietTo;
+};
+
+#endif // POWERMANAGER_H
@@ -0,0 +1,114 @@
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include "watertower.h"
+#include "sensormarker.h"
+
+static const int MarkerRadius = 18;
+static const int LabelHeight = 20;
+static const int LabelWidth = 120;
+
+SensorMarker::SensorMarker(WaterTower *waterTower, const QString &name, QGraphicsItem *parent) :
+    QGraphicsObject(parent),
+    waterTower(waterTower),
+    name(name),
+    level(0),
+    connected(false),
+    alarm(false)
+{
+    setFlag(QGraphicsItem::ItemIgnoresTransformations);
+    setToolTip(name);
+
+    connect(waterTower, SIGNAL(waterLevelChanged(int)), this, SLOT(waterLevelChanged(int)));
+    connect(waterTower, SIGNAL(deviceConnected()), this, SLOT(deviceConnect()));
+    connect(waterTower, SIGNAL(deviceDisconnected()), this, SLOT(deviceDisconnect()));
+    connect(waterTower, SIGNAL(highWaterLevelAlarm()), this, SLOT(highWaterLevelAlarm()));
+    connect(waterTower, SIGNAL(alarmCleared()), this, SLOT(alarmCleared()));
+}
+
+QRectF SensorMarker::boundingRect() const
+{
+    return QRectF(-LabelWidth / 2, -MarkerRadius - 4, LabelWidth, 2 * MarkerRadius + 4 + LabelHeight);
+}
+
+void SensorMarker::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    QRectF disc(-MarkerRadius, -MarkerRadius, 2 * MarkerRadius, 2 * MarkerRadius);
+    painter->setPen(QPen(Qt::darkGray, 2));
+    painter->setBrush(connected ? QColor(255, 255, 255, 220) : QColor(Qt::lightGray));
+    painter->drawEllipse(disc);
+
+    if (connected) {
+        /* water level as a filled chord of the disc */
+        QPainterPath clip;
+        clip.addEllipse(disc);
+        qreal top = disc.bottom() - disc.height() * level / 100;
+        painter->save();
+        painter->setClipPath(clip);
+        painter->fillRect(QRectF(disc.left(), top, disc.width(), disc.bottom() - top),
+                          QColor(255 * level / 100, 0, 255 - 255 * level / 100));
+        painter->restore();
+    }
+
+    if (alarm) {
+        QRectF badge(MarkerRadius - 10, -MarkerRadius - 4, 16, 16);
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(Qt::red);
+        painter->drawEllipse(badge);
+        painter->setPen(Qt::white);
+        painter->drawText(badge, Qt::AlignCenter, "!");
+    }
+
+    painter->setPen(connected ? Qt::black : Qt::darkGray);
+    painter->drawText(QRectF(-LabelWidth / 2, MarkerRadius, LabelWidth, LabelHeight),
+                      Qt::AlignHCenter | Qt::AlignTop, name);
+}
+
+void SensorMarker::waterLevelChanged(int centimetre)
+{
+    int height = waterTower->getHeight();
+    int percent = height > 0 ? qBound(0, 100 * centimetre / height, 100) : 0;
+
+    if (percent != level || !connected) {
+        level = percent;
+        connected = true;
+        update();
+    }
+}
+
+void SensorMarker::deviceConnect()
+{
+    if (!connected) {
+        connected = true;
+        update();
+    }
+}
+
+void SensorMarker::deviceDisconnect()
+{
+    if (connected) {
+        connected = false;
+        update();
+    }
+}
+
+void SensorMarker::highWaterLevelAlarm()
+{
+    if (!alarm) {
+        alarm = true;
+        update();
+    }
+}
+
+void SensorMarker::alarmCleared()
+{
+    if (alarm) {
+        alarm = false;
+        update();
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef SENSORMARKER_H
+#define SENSORMARKER_H
+
+#include <QGraphicsObject>
+
+class WaterTower;
+
+/*
+ * Live marker of one sensor node on the BabyCare floor plan.
+ *
+ * Keeps a constant on-screen size and repaints itself only when the level,
+ * link state or alarm state it shows has actually changed.
+ */
+class SensorMarker : public QGraphicsObject
+{
+    Q_OBJECT
+
+public:
+    explicit SensorMarker(WaterTower *waterTower, const QString &name, QGraphicsItem *parent = 0);
+
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+public slots:
+    void waterLevelChanged(int centimetre);
+    void deviceConnect();
+    void deviceDisconnect();
+    void highWaterLevelAlarm();
+    void alarmCleared();
+
+private:
+    WaterTower *waterTower;
+    QString name;
+
+    int level;      /*  percent of the tower height  */
+    bool connected;
+    bool alarm;
+};
+
+#endif // SENSORMARKER_H
@@ -0,0 +1,82 @@
+# Everything of the server but main(), shared with the benchmarks
+
+QT       += core gui multimedia network
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+INCLUDEPATH += $$PWD
+
+SOURCES += $$PWD/mainwindow.cpp \
+    $$PWD/watertower.cpp \
+    $$PWD/watertowerwidget.cpp \
+    $$PWD/avatarwidget.cpp \
+    $$PWD/alarmcontroller.cpp \
+    $$PWD/settings.cpp \
+    $$PWD/multipointcom.cpp \
+    $$PWD/notifypanel.cpp \
+    $$PWD/babycare.cpp \
+    $$PWD/hal.cpp \
+    $$PWD/datetimesettingsdialog.cpp \
+    $$PWD/watchdog.cpp \
+    $$PWD/keypresseater.cpp \
+    $$PWD/bootprofiler.cpp \
+    $$PWD/levelgauge.cpp \
+    $$PWD/watertowergrid.cpp \
+    $$PWD/floorplanitem.cpp \
+    $$PWD/sensormarker.cpp \
+    $$PWD/waterlevelhistory.cpp \
+    $$PWD/historychart.cpp \
+    $$PWD/audioclips.cpp \
+    $$PWD/pcmplayer.cpp \
+    $$PWD/notifyqueue.cpp \
+    $$PWD/alarmjournal.cpp \
+    $$PWD/powermanager.cpp \
+    $$PWD/eventloopmonitor.cpp \
+    $$PWD/application.cpp \
+    $$PWD/metricsserver.cpp \
+    $$PWD/telemetryserver.cpp \
+    $$PWD/httpserver.cpp \
+    $$PWD/soaktest.cpp \
+    $$PWD/jitterbuffer.cpp \
+    $$PWD/audiostream.cpp
+
+HEADERS  += $$PWD/mainwindow.h \
+    $$PWD/watertower.h \
+    $$PWD/watertowerwidget.h \
+    $$PWD/avatarwidget.h \
+    $$PWD/multipointcom.h \
+    $$PWD/alarmcontroller.h \
+    $$PWD/settings.h \
+    $$PWD/notifypanel.h \
+    $$PWD/babycare.h \
+    $$PWD/hal.h \
+    $$PWD/datetimesettingsdialog.h \
+    $$PWD/watchdog.h \
+    $$PWD/keypresseater.h \
+    $$PWD/bootprofiler.h \
+    $$PWD/levelgauge.h \
+    $$PWD/watertowergrid.h \
+    $$PWD/floorplanitem.h \
+    $$PWD/sensormarker.h \
+    $$PWD/waterlevelhistory.h \
+    $$PWD/historychart.h \
+    $$PWD/audioclips.h \
+    $$PWD/pcmplayer.h \
+    $$PWD/notifyqueue.h \
+    $$PWD/alarmjournal.h \
+    $$PWD/powermanager.h \
+    $$PWD/eventloopmonitor.h \
+    $$PWD/application.h \
+    $$PWD/metricsserver.h \
+    $$PWD/telemetryserver.h \
+    $$PWD/httpserver.h \
+    $$PWD/soaktest.h \
+    $$PWD/jitterbuffer.h \
+    $$PWD/audiostream.h
+
+FORMS    += $$PWD/mainwindow.ui \
+    $$PWD/watertowerwidget.ui \
+    $$PWD/datetimesettingsdialog.ui
+
+RESOURCES += \
+    $$PWD/skynet.qrc
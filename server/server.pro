@@ -4,10 +4,6 @@
 #
 #-------------------------------------------------
 
-QT       += core gui multimedia network
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
 TARGET = skynet
 TEMPLATE = app
 
@@ -16,43 +12,11 @@ RCC_DIR = rcc
 MOC_DIR = moc
 OBJECTS_DIR = objs
 
-SOURCES += main.cpp\
-        mainwindow.cpp \
-    watertower.cpp \
-    watertowerwidget.cpp \
-    avatarwidget.cpp \
-    alarmcontroller.cpp \
-    settings.cpp \
-    multipointcom.cpp \
-    notifypanel.cpp \
-    babycare.cpp \
-    hal.cpp \
-    datetimesettingsdialog.cpp \
-    watchdog.cpp \
-    keypresseater.cpp
+include(server.pri)
 
-HEADERS  += mainwindow.h \
-    watertower.h \
-    watertowerwidget.h \
-    avatarwidget.h \
-    multipointcom.h \
-    alarmcontroller.h \
-    settings.h \
-    notifypanel.h \
-    babycare.h \
-    hal.h \
-    datetimesettingsdialog.h \
-    watchdog.h \
-    keypresseater.h
-
-FORMS    += mainwindow.ui \
-    watertowerwidget.ui \
-    datetimesettingsdialog.ui
+SOURCES += main.cpp
 
 TRANSLATIONS += skynet_zh_CN.ts
 
-RESOURCES += \
-    skynet.qrc
-
 OTHER_FILES += \
     skynet_zh_CN.ts
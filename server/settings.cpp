@@ -2,6 +2,7 @@
 #include "settings.h"
 
 Settings *Settings::self = 0;
+QString Settings::dataPath;
 
 Settings::Settings(const QString &fileName, Format format, QObject *parent) :
     QSettings(fileName, format, parent)
@@ -11,10 +12,27 @@ Settings::Settings(const QString &fileName, Format format, QObject *parent) :
 Settings *Settings::instance()
 {
     if (!self)
-        self = new Settings(qApp->applicationDirPath() + "/config.ini");
+        self = new Settings(dataDirectory() + "/config.ini");
     return self;
 }
 
+/*
+ * Where the settings, the alarm journal, the level history, the floor plan
+ * cache and the boot profile are written, next to the binary by default.
+ * Images and sounds are always read from there. Must be called before any
+ * of them is first used.
+ */
+void Settings::setDataDirectory(const QString &path)
+{
+    dataPath = path;
+}
+
+/* static */
+QString Settings::dataDirectory()
+{
+    return dataPath.isEmpty() ? qApp->applicationDirPath() : dataPath;
+}
+
 void Settings::setBrightness(int value)
 {
     setValue("Brightness", value);
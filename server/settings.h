@@ -11,6 +11,9 @@ class Settings : public QSettings
 public:
     static Settings *instance();
 
+    static void setDataDirectory(const QString &path);
+    static QString dataDirectory();
+
     void setBrightness(int value);
     int getBrightness();
 
@@ -38,6 +41,7 @@ private:
 
 private:
     static Settings *self;
+    static QString dataPath;
 };
 
 #endif // SETTINGS_H
@@ -0,0 +1,216 @@
+#include <QApplication>
+#include <QDir>
+#include <QTimer>
+#include <QTextStream>
+#include <QtAlgorithms>
+#include <QDebug>
+
+#include "settings.h"
+#include "watertower.h"
+#include "soaktest.h"
+
+static const int SampleInterval = 60 * 1000;
+static const double WarmUp = 0.25;     /*  hours left out of the growth fits  */
+
+enum Field {
+    Rss,
+    Fds,
+    Threads
+};
+
+SoakTest::SoakTest(double hours, const QString &reportFile, QObject *parent) :
+    QObject(parent),
+    duration(hours),
+    towers(WaterTower::MaxQuantity),
+    report(reportFile),
+    passed(true)
+{
+    clock.start();
+
+    for (int i = 0; i < towers.count(); i++) {
+        WaterTower *waterTower = WaterTower::instance(i);
+        Tower &tower = towers[i];
+        tower.identity = i;
+        tower.enabled = waterTower->isEnabled();
+        tower.sentAt = -1;
+        tower.requests = 0;
+        tower.missed = 0;
+        tower.disconnects = 0;
+        tower.busyAtStart = waterTower->statistics().busy.load();
+
+        connect(waterTower, SIGNAL(requestSent()), this, SLOT(requestSent()));
+        connect(waterTower, SIGNAL(waterLevelChanged(int)), this, SLOT(waterLevelChanged()));
+        connect(waterTower, SIGNAL(deviceDisconnected()), this, SLOT(deviceDisconnected()));
+    }
+
+    if (!report.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        qDebug() << "Soak report can not be opened" << report.fileName();
+    QTextStream(&report) << "hours\trss_kib\tfds\tthreads\n";
+
+    sampleTimer = new QTimer(this);
+    connect(sampleTimer, SIGNAL(timeout()), this, SLOT(tick()));
+    sampleTimer->start(int(qBound(qint64(1000), qint64(hours * 3600 * 1000), qint64(SampleInterval))));
+    sample();
+
+    qDebug() << "Soak test for" << hours << "hour(s), report" << report.fileName();
+}
+
+void SoakTest::requestSent()
+{
+    Tower *tower = towerOf(sender());
+    if (!tower)
+        return;
+
+    /* the previous request never produced a reading */
+    if (tower->sentAt >= 0)
+        tower->missed++;
+    tower->requests++;
+    tower->sentAt = clock.nsecsElapsed();
+}
+
+void SoakTest::waterLevelChanged()
+{
+    Tower *tower = towerOf(sender());
+    if (!tower || tower->sentAt < 0)
+        return;
+
+    tower->latencies.append((clock.nsecsElapsed() - tower->sentAt) / 1000);
+    tower->sentAt = -1;
+}
+
+void SoakTest::deviceDisconnected()
+{
+    Tower *tower = towerOf(sender());
+    if (tower)
+        tower->disconnects++;
+}
+
+void SoakTest::tick()
+{
+    sample();
+    if (clock.elapsed() >= duration * 3600 * 1000)
+        finish();
+}
+
+void SoakTest::sample()
+{
+    Sample sample;
+    sample.hours = clock.elapsed() / 3600000.0;
+    sample.rss = 0;
+    sample.threads = 0;
+
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        foreach (const QByteArray &line, status.readAll().split('\n')) {
+            if (line.startsWith("VmRSS:"))
+                sample.rss = line.mid(6).trimmed().split(' ').first().toLongLong();
+            else if (line.startsWith("Threads:"))
+                sample.threads = line.mid(8).trimmed().toInt();
+        }
+    }
+    sample.fds = QDir("/proc/self/fd").entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::System).count();
+
+    samples.append(sample);
+    QTextStream(&report) << sample.hours << "\t" << sample.rss << "\t" << sample.fds << "\t" << sample.threads << "\n";
+    report.flush();
+}
+
+void SoakTest::finish()
+{
+    sampleTimer->stop();
+
+    QTextStream out(&report);
+    out << "\ntower\trequests\tmissed\tbusy\tdisconnects\tp50_us\tp99_us\tmax_us\n";
+
+    Settings *settings = Settings::instance();
+    settings->beginGroup("Soak");
+    double p99Limit = settings->value("p99", 100000).toDouble();
+    double maxLimit = settings->value("max", 500000).toDouble();
+    double missedLimit = settings->value("missed", 0.01).toDouble();
+    double disconnectLimit = settings->value("disconnects", 0).toDouble();
+    double rssLimit = settings->value("rssPerHour", 256).toDouble();
+    double fdLimit = settings->value("fdsPerHour", 0.5).toDouble();
+    double threadLimit = settings->value("threadsPerHour", 0.5).toDouble();
+    settings->endGroup();
+
+    QString results;
+    QTextStream verdicts(&results);
+    for (int i = 0; i < towers.count(); i++) {
+        Tower &tower = towers[i];
+        if (!tower.enabled)
+            continue;
+
+        int busy = WaterTower::instance(i)->statistics().busy.load() - tower.busyAtStart;
+        qSort(tower.latencies);
+        quint32 p50 = percentile(tower.latencies, 50);
+        quint32 p99 = percentile(tower.latencies, 99);
+        quint32 max = tower.latencies.isEmpty() ? 0 : tower.latencies.last();
+        out << tower.identity << "\t" << tower.requests << "\t" << tower.missed << "\t" << busy
+            << "\t" << tower.disconnects << "\t" << p50 << "\t" << p99 << "\t" << max << "\n";
+
+        QString name = QString("tower %1 ").arg(tower.identity);
+        int polls = tower.requests + busy;
+        check(verdicts, name + "p99 latency us", p99, p99Limit);
+        check(verdicts, name + "max latency us", max, maxLimit);
+        check(verdicts, name + "missed poll ratio", polls ? double(tower.missed + busy) / polls : 1, missedLimit);
+        check(verdicts, name + "disconnects", tower.disconnects, disconnectLimit);
+    }
+
+    check(verdicts, "rss growth KiB/h", slope(Rss), rssLimit);
+    check(verdicts, "fd growth /h", slope(Fds), fdLimit);
+    check(verdicts, "thread growth /h", slope(Threads), threadLimit);
+
+    verdicts.flush();
+    out << "\n" << results << (passed ? "PASS\n" : "FAIL\n");
+    out.flush();
+    report.close();
+
+    QTextStream(stdout) << results << (passed ? "PASS" : "FAIL") << endl;
+    qApp->exit(passed ? 0 : 1);
+}
+
+SoakTest::Tower *SoakTest::towerOf(QObject *sender)
+{
+    WaterTower *waterTower = qobject_cast<WaterTower *>(sender);
+    if (!waterTower || !towers.at(waterTower->getIdentity()).enabled)
+        return 0;
+    return &towers[waterTower->getIdentity()];
+}
+
+/* static, nearest rank */
+quint32 SoakTest::percentile(const QVector<quint32> &sorted, int percent)
+{
+    if (sorted.isEmpty())
+        return 0;
+    int rank = (sorted.count() * percent + 99) / 100;
+    return sorted.at(qBound(0, rank - 1, sorted.count() - 1));
+}
+
+/* least squares growth per hour of a sampled figure, after the warm up */
+double SoakTest::slope(int field) const
+{
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    foreach (const Sample &sample, samples) {
+        if (sample.hours < WarmUp)
+            continue;
+        double y = field == Rss ? sample.rss : field == Fds ? sample.fds : sample.threads;
+        n++;
+        sx += sample.hours;
+        sy += y;
+        sxx += sample.hours * sample.hours;
+        sxy += sample.hours * y;
+    }
+
+    double d = n * sxx - sx * sx;
+    if (n < 2 || d <= 0)
+        return 0;
+    return (n * sxy - sx * sy) / d;
+}
+
+bool SoakTest::check(QTextStream &out, const QString &name, double value, double limit)
+{
+    bool ok = value <= limit;
+    out << (ok ? "pass\t" : "FAIL\t") << name << "\t" << value << "\tlimit " << limit << "\n";
+    passed = passed && ok;
+    return ok;
+}
@@ -0,0 +1,74 @@
+#ifndef SOAKTEST_H
+#define SOAKTEST_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QFile>
+
+class QTimer;
+class QTextStream;
+
+/*
+ * Long running check of the whole poll path against the node simulator.
+ *
+ * For every enabled tower the latency from sending a request to the
+ * delivery of waterLevelChanged is recorded, together with polls that got
+ * no reading and disconnects. Resident memory, open descriptors and threads
+ * are sampled every minute and written to the report; their growth per hour
+ * after a warm up is fitted by least squares. At the end each figure is
+ * checked against the limits of the [Soak] settings group, p99 and max
+ * (microseconds), missed (ratio of polls), disconnects, rssPerHour (KiB),
+ * fdsPerHour and threadsPerHour. The process exits with 0 when all of them
+ * passed, 1 otherwise.
+ */
+class SoakTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    SoakTest(double hours, const QString &reportFile, QObject *parent = 0);
+
+private slots:
+    void requestSent();
+    void waterLevelChanged();
+    void deviceDisconnected();
+    void tick();
+
+private:
+    struct Tower {
+        int identity;
+        bool enabled;
+        qint64 sentAt;          /*  nsecs on clock, -1 when nothing is outstanding  */
+        QVector<quint32> latencies;     /*  measured in the unit of "microsecond"  */
+        int requests;
+        int missed;
+        int disconnects;
+        int busyAtStart;
+    };
+
+    struct Sample {
+        double hours;
+        qint64 rss;             /*  measured in the unit of "KiB"  */
+        int fds;
+        int threads;
+    };
+
+    void sample();
+    void finish();
+    Tower *towerOf(QObject *sender);
+    static quint32 percentile(const QVector<quint32> &sorted, int percent);
+    double slope(int field) const;
+    bool check(QTextStream &out, const QString &name, double value, double limit);
+
+private:
+    double duration;            /*  measured in the unit of "hour"  */
+    QElapsedTimer clock;
+    QTimer *sampleTimer;
+    QVector<Tower> towers;
+    QList<Sample> samples;
+    QFile report;
+    bool passed;
+};
+
+#endif // SOAKTEST_H
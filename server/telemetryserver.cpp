@@ -0,0 +1,258 @@
+#include <QApplication>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QDataStream>
+#include <QDateTime>
+#include <QTimer>
+#include <QDebug>
+
+#include "settings.h"
+#include "watertower.h"
+#include "telemetryserver.h"
+
+TelemetryServer *TelemetryServer::self = 0;
+
+static const int FlushDelay = 50;           /*  coalesce bursts of changes into one frame  */
+static const qint64 MaxBacklog = 64 * 1024; /*  per client, measured in the unit of "byte"  */
+static const int MaxStale = 30 * 1000;
+static const int MaxInput = 256;
+
+TelemetryServer::TelemetryServer(QObject *parent) :
+    QObject(parent)
+{
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    connect(flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        WaterTower *tower = WaterTower::instance(i);
+        connect(tower, SIGNAL(waterLevelChanged(int)), this, SLOT(towerChanged()));
+        connect(tower, SIGNAL(waterLevelRangeChanged(int,int)), this, SLOT(towerChanged()));
+        connect(tower, SIGNAL(deviceConnected()), this, SLOT(towerChanged()));
+        connect(tower, SIGNAL(deviceDisconnected()), this, SLOT(towerChanged()));
+        connect(tower, SIGNAL(highWaterLevelAlarm()), this, SLOT(towerChanged()));
+        published.insert(i, stateOf(i));
+    }
+
+    int port = Settings::instance()->value("TelemetryPort", 9106).toInt();
+    QHostAddress address(Settings::instance()->value("TelemetryAddress", "0.0.0.0").toString());
+
+    server = new QTcpServer(this);
+    connect(server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+    if (port > 0 && !server->listen(address, port))
+        qDebug() << "Telemetry can not listen on" << address.toString() << port << server->errorString();
+}
+
+TelemetryServer *TelemetryServer::instance()
+{
+    if (!self)
+        self = new TelemetryServer(qApp);
+    return self;
+}
+
+void TelemetryServer::newConnection()
+{
+    while (server->hasPendingConnections()) {
+        QTcpSocket *client = server->nextPendingConnection();
+        client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+        Subscriber subscriber;
+        subscriber.towers = (1u << WaterTower::MaxQuantity) - 1;
+        subscriber.stale = false;
+        subscribers.insert(client, subscriber);
+
+        connect(client, SIGNAL(readyRead()), this, SLOT(readFrames()));
+        connect(client, SIGNAL(bytesWritten(qint64)), this, SLOT(bytesWritten()));
+        connect(client, SIGNAL(disconnected()), this, SLOT(clientClosed()));
+        qDebug() << "Telemetry subscriber" << client->peerAddress().toString() << "joined";
+
+        sendSnapshot(client);
+    }
+}
+
+void TelemetryServer::readFrames()
+{
+    QTcpSocket *client = qobject_cast<QTcpSocket *>(sender());
+    if (!client || !subscribers.contains(client))
+        return;
+
+    QByteArray &input = subscribers[client].input;
+    input.append(client->readAll());
+
+    while (input.size() >= 2) {
+        int length = quint8(input.at(0)) | (quint8(input.at(1)) << 8);
+        if (length > MaxInput) {
+            client->abort();
+            return;
+        }
+        if (input.size() < 2 + length)
+            break;
+
+        QDataStream in(input.mid(2, length));
+        in.setByteOrder(QDataStream::LittleEndian);
+        quint8 type;
+        quint32 towers;
+        in >> type >> towers;
+        input.remove(0, 2 + length);
+
+        if (type == Subscribe && in.status() == QDataStream::Ok) {
+            subscribers[client].towers = towers;
+            sendSnapshot(client);
+        }
+    }
+
+    if (input.size() > MaxInput)
+        client->abort();
+}
+
+void TelemetryServer::bytesWritten()
+{
+    QTcpSocket *client = qobject_cast<QTcpSocket *>(sender());
+    if (!client || !subscribers.contains(client))
+        return;
+
+    if (subscribers[client].stale && client->bytesToWrite() < MaxBacklog / 2)
+        sendSnapshot(client);
+}
+
+void TelemetryServer::clientClosed()
+{
+    QTcpSocket *client = qobject_cast<QTcpSocket *>(sender());
+    subscribers.remove(client);
+    client->deleteLater();
+}
+
+void TelemetryServer::towerChanged()
+{
+    WaterTower *tower = qobject_cast<WaterTower *>(sender());
+    if (tower && !dirty.contains(tower->getIdentity()))
+        dirty.append(tower->getIdentity());
+    if (!flushTimer->isActive())
+        flushTimer->start(FlushDelay);
+}
+
+void TelemetryServer::flush()
+{
+    /* one record per changed tower, shared by every subscriber */
+    QHash<int, QByteArray> records;
+    foreach (int identity, dirty) {
+        State state = stateOf(identity);
+        const State &last = published[identity];
+        quint8 fields = 0;
+        if (state.level != last.level)
+            fields |= Level;
+        if (state.height != last.height)
+            fields |= Height;
+        if (state.connected != last.connected)
+            fields |= Connected;
+        if (state.alarm != last.alarm)
+            fields |= Alarm;
+        if (fields)
+            records.insert(identity, record(identity, state, fields));
+        published[identity] = state;
+    }
+    dirty.clear();
+
+    if (records.isEmpty())
+        return;
+
+    /* abort() removes the subscriber right away, iterate over a copy */
+    foreach (QTcpSocket *client, subscribers.keys()) {
+        const Subscriber &subscriber = subscribers[client];
+        if (subscriber.stale) {
+            if (subscriber.staleSince.elapsed() > MaxStale) {
+                qDebug() << "Telemetry subscriber" << client->peerAddress().toString() << "too slow, dropped";
+                client->abort();
+            }
+            continue;
+        }
+
+        QList<QByteArray> selected;
+        QHash<int, QByteArray>::const_iterator r;
+        for (r = records.constBegin(); r != records.constEnd(); ++r) {
+            if (subscriber.towers & (1u << r.key()))
+                selected.append(r.value());
+        }
+        if (!selected.isEmpty())
+            send(client, frame(Delta, selected));
+    }
+}
+
+/* static */
+TelemetryServer::State TelemetryServer::stateOf(int identity)
+{
+    WaterTower *tower = WaterTower::instance(identity);
+    State state;
+    state.level = tower->getWaterLevel();
+    state.height = tower->getHeight();
+    state.connected = tower->isDeviceConnected();
+    state.alarm = tower->isAlarmActive();
+    return state;
+}
+
+/* static */
+QByteArray TelemetryServer::record(int identity, const State &state, quint8 fields)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << quint8(identity) << fields;
+    if (fields & Level)
+        out << state.level;
+    if (fields & Height)
+        out << state.height;
+    if (fields & Connected)
+        out << state.connected;
+    if (fields & Alarm)
+        out << state.alarm;
+    return data;
+}
+
+/* static */
+QByteArray TelemetryServer::frame(FrameType type, const QList<QByteArray> &records)
+{
+    QByteArray body;
+    QDataStream out(&body, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << quint8(type) << quint32(QDateTime::currentMSecsSinceEpoch() / 1000) << quint8(records.count());
+    foreach (const QByteArray &record, records)
+        body.append(record);
+
+    QByteArray data;
+    data.reserve(2 + body.size());
+    data.append(char(body.size() & 0xff));
+    data.append(char(body.size() >> 8));
+    data.append(body);
+    return data;
+}
+
+/* from the published state, so that the following deltas apply on top of it */
+void TelemetryServer::sendSnapshot(QTcpSocket *client)
+{
+    Subscriber &subscriber = subscribers[client];
+    QList<QByteArray> records;
+    for (int i = 0; i < WaterTower::MaxQuantity; i++) {
+        if (subscriber.towers & (1u << i))
+            records.append(record(i, published.value(i), AllFields));
+    }
+
+    if (send(client, frame(Snapshot, records)))
+        subscriber.stale = false;
+}
+
+/* Returns false, and marks the client stale, instead of queueing more than MaxBacklog bytes */
+bool TelemetryServer::send(QTcpSocket *client, const QByteArray &data)
+{
+    Subscriber &subscriber = subscribers[client];
+
+    if (client->bytesToWrite() + data.size() > MaxBacklog) {
+        if (!subscriber.stale) {
+            subscriber.stale = true;
+            subscriber.staleSince.start();
+        }
+        return false;
+    }
+
+    client->write(data);
+    return true;
+}
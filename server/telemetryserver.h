@@ -0,0 +1,95 @@
+#ifndef TELEMETRYSERVER_H
+#define TELEMETRYSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QElapsedTimer>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+/*
+ * Streams tower state to remote subscribers over TCP.
+ *
+ * Every frame is a little endian quint16 length, covering the rest of the
+ * frame, a quint8 type and its payload.
+ *
+ *   client  Subscribe  0x01  quint32 tower mask, bit n for tower n
+ *   server  Snapshot   0x81  quint32 time, quint8 count, count records
+ *           Delta      0x82  quint32 time, quint8 count, count records
+ *
+ * A record is quint8 tower, quint8 field mask and then only the fields set
+ * in the mask, in bit order: Level qint16, Height qint16 (centimetre),
+ * Connected quint8, Alarm quint8. Snapshots carry every field of every
+ * subscribed tower; deltas only what changed since the previous frame.
+ *
+ * A new connection is subscribed to all towers and gets a snapshot, a
+ * Subscribe frame replaces the filter and is answered with a new snapshot.
+ * Deltas for a client whose socket buffer is full are dropped rather than
+ * queued, it gets a snapshot once the buffer has drained instead.
+ */
+class TelemetryServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum FrameType {
+        Subscribe = 0x01,
+        Snapshot = 0x81,
+        Delta = 0x82
+    };
+
+    enum Field {
+        Level = 0x01,
+        Height = 0x02,
+        Connected = 0x04,
+        Alarm = 0x08,
+        AllFields = 0x0f
+    };
+
+    static TelemetryServer *instance();
+
+private slots:
+    void newConnection();
+    void readFrames();
+    void bytesWritten();
+    void clientClosed();
+    void towerChanged();
+    void flush();
+
+private:
+    explicit TelemetryServer(QObject *parent = 0);
+    Q_DISABLE_COPY(TelemetryServer)
+
+    struct State {
+        qint16 level;
+        qint16 height;
+        quint8 connected;
+        quint8 alarm;
+    };
+
+    struct Subscriber {
+        quint32 towers;
+        bool stale;             /*  deltas were dropped, owes a snapshot  */
+        QElapsedTimer staleSince;
+        QByteArray input;
+    };
+
+    static State stateOf(int identity);
+    static QByteArray record(int identity, const State &state, quint8 fields);
+    static QByteArray frame(FrameType type, const QList<QByteArray> &records);
+    void sendSnapshot(QTcpSocket *client);
+    bool send(QTcpSocket *client, const QByteArray &data);
+
+private:
+    static TelemetryServer *self;
+
+    QTcpServer *server;
+    QTimer *flushTimer;
+    QHash<QTcpSocket *, Subscriber> subscribers;
+    QHash<int, State> published;    /*  state as of the last delta, by tower  */
+    QList<int> dirty;
+};
+
+#endif // TELEMETRYSERVER_H
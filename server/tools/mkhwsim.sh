@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Build a simulated hardware tree for skynet --hardware-root <dir>.
+#
+# The layout mirrors the sysfs and device paths used by Hal and Watchdog.
+# Every write Hal makes is appended to <dir>/writes.log with a timestamp.
+# A tmpfs directory works best:
+#
+#   mkdir -p /tmp/hwsim && mount -t tmpfs none /tmp/hwsim
+#   ./tools/mkhwsim.sh /tmp/hwsim
+#   ./skynet --hardware-root /tmp/hwsim
+#
+# The radio is not part of the tree, MultiPointCom still needs /dev/si4432.
+#
+# Pass --leds to also create /sys/class/leds devices, so the kernel timer
+# trigger path is exercised instead of the plain gpio lines.
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 <dir> [--leds]" >&2
+    exit 1
+fi
+
+root=$1
+
+mkdir -p "$root/dev"
+: > "$root/dev/watchdog"
+
+for gpio in 295 296; do
+    mkdir -p "$root/sys/class/gpio/gpio$gpio"
+    echo 0 > "$root/sys/class/gpio/gpio$gpio/value"
+done
+
+backlight="$root/sys/class/backlight/pwm-backlight.0"
+mkdir -p "$backlight"
+echo 7 > "$backlight/max_brightness"
+echo 7 > "$backlight/brightness"
+
+if [ "$2" = "--leds" ]; then
+    for led in red yellow blue; do
+        mkdir -p "$root/sys/class/leds/$led"
+        echo 0 > "$root/sys/class/leds/$led/brightness"
+        echo none > "$root/sys/class/leds/$led/trigger"
+        echo 500 > "$root/sys/class/leds/$led/delay_on"
+        echo 500 > "$root/sys/class/leds/$led/delay_off"
+    done
+fi
+
+: > "$root/writes.log"
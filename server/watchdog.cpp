@@ -6,30 +6,55 @@
 #include <linux/watchdog.h>
 #endif
 
+#include <QThread>
 #include <QTimer>
+#include <QStringList>
 #include <QDebug>
 
+#include "hal.h"
 #include "watchdog.h"
 
 Watchdog *Watchdog::self = 0;
 
 Watchdog::Watchdog(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    fd(-1)
 {
+    if (Hal::isSimulated()) {
+        /* keepalives are recorded in the simulated tree instead */
+        qDebug() << "Watchdog simulated";
+        Hal::instance();    /*  created here, on the GUI thread  */
+    } else {
 #ifdef __arm__
-    fd = open("/dev/watchdog", O_WRONLY);
+        fd = open("/dev/watchdog", O_WRONLY);
 
-    if (fd == -1) {
-        qDebug() << "Watchdog device not enabled";
-    }
+        if (fd == -1) {
+            qDebug() << "Watchdog device not enabled";
+        }
 
-    int flags = WDIOS_ENABLECARD;
-    ioctl(fd, WDIOC_SETOPTIONS, &flags);
+        int flags = WDIOS_ENABLECARD;
+        ioctl(fd, WDIOC_SETOPTIONS, &flags);
 #endif
+    }
+
+    clock.start();
 
+    /* off the GUI thread, so a stalled event loop is just another late subsystem */
     timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), this, SLOT(keepAlive()));
-    timer->start(1000);
+    timer->setInterval(1000);
+
+    thread = new QThread();
+    moveToThread(thread);
+    connect(thread, SIGNAL(started()), timer, SLOT(start()));
+    thread->start();
+}
+
+Watchdog::~Watchdog()
+{
+    thread->quit();
+    thread->wait();
+    delete thread;
 }
 
 Watchdog *Watchdog::instance()
@@ -39,8 +64,50 @@ Watchdog *Watchdog::instance()
     return self;
 }
 
+/* Thread safe, deadline is measured in the unit of "millisecond" */
+void Watchdog::checkIn(const QString &name, int deadline)
+{
+    QMutexLocker locker(&mutex);
+    due[name] = clock.elapsed() + deadline;
+    if (reported.remove(name))
+        qDebug() << "Watchdog" << name << "checked in again";
+}
+
+void Watchdog::release(const QString &name)
+{
+    QMutexLocker locker(&mutex);
+    due.remove(name);
+    reported.remove(name);
+}
+
+QStringList Watchdog::overdue()
+{
+    QMutexLocker locker(&mutex);
+    QStringList names;
+    qint64 now = clock.elapsed();
+    QHash<QString, qint64>::const_iterator i;
+    for (i = due.constBegin(); i != due.constEnd(); ++i) {
+        if (i.value() >= now)
+            continue;
+        names << i.key();
+        if (!reported.contains(i.key())) {
+            reported.insert(i.key());
+            qDebug() << "Watchdog withheld," << i.key() << "overdue by" << now - i.value() << "ms";
+        }
+    }
+    return names;
+}
+
 void Watchdog::keepAlive()
 {
+    if (!overdue().isEmpty())
+        return;
+
+    if (Hal::isSimulated()) {
+        Hal::instance()->writeAttribute("/dev/watchdog", "keepalive");
+        return;
+    }
+
 #ifdef __arm__
     int dummy;
     ioctl(fd, WDIOC_KEEPALIVE, &dummy);
@@ -2,9 +2,19 @@
 #define WATCHDOG_H
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
 
 class QTimer;
+class QThread;
 
+/*
+ * Pets /dev/watchdog from its own thread, but only while every subsystem
+ * that has checked in did so again within its deadline. A subsystem is
+ * registered by its first checkIn() and dropped again by release().
+ */
 class Watchdog : public QObject
 {
     Q_OBJECT
@@ -12,18 +22,30 @@ class Watchdog : public QObject
 public:
     static Watchdog *instance();
 
+    void checkIn(const QString &name, int deadline);
+    void release(const QString &name);
+
+    QStringList overdue();
+
 public slots:
     void keepAlive();
 
 private:
     explicit Watchdog(QObject *parent = 0);
+    ~Watchdog();
     Q_DISABLE_COPY(Watchdog)
 
 private:
     static Watchdog *self;
 
     int fd;
+    QThread *thread;
     QTimer *timer;
+
+    QMutex mutex;
+    QElapsedTimer clock;
+    QHash<QString, qint64> due;     /*  subsystem to its next deadline on clock  */
+    QSet<QString> reported;
 };
 
 #endif // WATCHDOG_H
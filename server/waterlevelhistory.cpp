@@ -0,0 +1,286 @@
+#include <algorithm>
+
+#include <QApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+
+#include "settings.h"
+#include "waterlevelhistory.h"
+
+const int WaterLevelHistory::MaxAge = 31 * 24 * 3600;
+const int WaterLevelHistory::BlockSize = 64;
+
+static const int CompactInterval = 3600 * 1000;   /*  measured in the unit of "millisecond"  */
+
+QMap<int, WaterLevelHistory*> WaterLevelHistory::instanceMap;
+
+static bool sampleBefore(const WaterLevelHistory::Sample &sample, quint32 time)
+{
+    return sample.time < time;
+}
+
+static quint32 now()
+{
+    return quint32(QDateTime::currentDateTimeUtc().toSecsSinceEpoch());
+}
+
+static bool writeSamples(QFile &file, const QVector<WaterLevelHistory::Sample> &samples, int first)
+{
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+    for (int i = first; i < samples.count(); i++)
+        out << samples.at(i).time << samples.at(i).level;
+    return file.flush() && out.status() == QDataStream::Ok;
+}
+
+/* writes a snapshot of the samples to a new file, off the GUI thread */
+class HistoryWriter : public QThread
+{
+public:
+    HistoryWriter(const QString &fileName, const QVector<WaterLevelHistory::Sample> &samples, QObject *parent = 0) :
+        QThread(parent),
+        fileName(fileName),
+        samples(samples),
+        succeeded(false)
+    {
+    }
+
+    bool hasSucceeded() const
+    {
+        return succeeded;
+    }
+
+protected:
+    virtual void run()
+    {
+        QFile file(fileName);
+        succeeded = file.open(QIODevice::WriteOnly | QIODevice::Truncate) && writeSamples(file, samples, 0);
+    }
+
+private:
+    QString fileName;
+    QVector<WaterLevelHistory::Sample> samples;
+    bool succeeded;
+};
+
+static void merge(WaterLevelHistory::Range &range, qint16 minimum, qint16 maximum)
+{
+    if (!range.valid) {
+        range.minimum = minimum;
+        range.maximum = maximum;
+        range.valid = true;
+    } else {
+        range.minimum = qMin(range.minimum, minimum);
+        range.maximum = qMax(range.maximum, maximum);
+    }
+}
+
+WaterLevelHistory::WaterLevelHistory(int identity, QObject *parent) :
+    QObject(parent),
+    identity(identity),
+    writer(0),
+    stale(false),
+    appendedSince(0)
+{
+    QDir().mkpath(Settings::dataDirectory() + "/history");
+    file.setFileName(QString("%1/history/watertower-%2.dat").arg(Settings::dataDirectory()).arg(identity));
+
+    compactTimer = new QTimer(this);
+    connect(compactTimer, SIGNAL(timeout()), this, SLOT(compact()));
+    compactTimer->start(CompactInterval);
+
+    load();
+    expire();
+    compact();
+}
+
+quint32 WaterLevelHistory::firstTime() const
+{
+    return data.isEmpty() ? 0 : data.first().time;
+}
+
+quint32 WaterLevelHistory::lastTime() const
+{
+    return data.isEmpty() ? 0 : data.last().time;
+}
+
+QVector<WaterLevelHistory::Sample> WaterLevelHistory::samples(quint32 from, quint32 to) const
+{
+    int first = lowerBound(from);
+    int last = lowerBound(to);
+    return data.mid(first, last - first);
+}
+
+void WaterLevelHistory::decimate(quint32 from, quint32 to, int buckets, QVector<Range> &ranges) const
+{
+    Range empty;
+    empty.minimum = 0;
+    empty.maximum = 0;
+    empty.valid = false;
+    ranges.fill(empty, qMax(0, buckets));
+
+    if (to <= from || buckets <= 0)
+        return;
+
+    double scale = double(buckets) / (to - from);
+    int i = lowerBound(from);
+    int end = lowerBound(to);
+
+    while (i < end) {
+        int bucket = qMin(int((data.at(i).time - from) * scale), buckets - 1);
+
+        /* a whole summary block falling into one bucket is merged at once */
+        if ((i % BlockSize) == 0 && (i + BlockSize) <= end) {
+            int last = qMin(int((data.at(i + BlockSize - 1).time - from) * scale), buckets - 1);
+            if (last == bucket) {
+                const Range &block = blocks.at(i / BlockSize);
+                merge(ranges[bucket], block.minimum, block.maximum);
+                i += BlockSize;
+                continue;
+            }
+        }
+
+        merge(ranges[bucket], data.at(i).level, data.at(i).level);
+        i++;
+    }
+}
+
+/* static */
+WaterLevelHistory *WaterLevelHistory::instance(int identity)
+{
+    WaterLevelHistory *history;
+
+    if (instanceMap.contains(identity)) {
+        history = instanceMap.value(identity);
+    } else {
+        history = new WaterLevelHistory(identity);
+        instanceMap[identity] = history;
+    }
+    return history;
+}
+
+void WaterLevelHistory::waterLevelChanged(int centimetre)
+{
+    Sample sample;
+    sample.time = now();
+    sample.level = centimetre;
+
+    /* the clock may have been set back, keep the series ordered */
+    if (!data.isEmpty() && sample.time < data.last().time)
+        sample.time = data.last().time;
+
+    append(sample);
+
+    if (file.isOpen())
+        writeSamples(file, data, data.count() - 1);
+    if (writer)
+        appendedSince++;
+
+    if ((data.count() % (BlockSize * 64)) == 0)
+        expire();
+
+    emit appended();
+}
+
+void WaterLevelHistory::load()
+{
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream in(&file);
+        in.setByteOrder(QDataStream::LittleEndian);
+        quint32 cutoff = now() - MaxAge;
+        data.reserve(file.size() / 6);
+        while (!in.atEnd()) {
+            Sample sample;
+            in >> sample.time >> sample.level;
+            if (in.status() != QDataStream::Ok)
+                break;
+            if ((sample.time < cutoff) || (!data.isEmpty() && sample.time < data.last().time)) {
+                stale = true;
+                continue;
+            }
+            append(sample);
+        }
+        /* a torn last sample is cut off by the rewrite */
+        if (!in.atEnd() || file.size() % 6)
+            stale = true;
+        file.close();
+    }
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        qDebug() << "Water level history can not be written" << file.fileName();
+}
+
+void WaterLevelHistory::append(const Sample &sample)
+{
+    if ((data.count() % BlockSize) == 0) {
+        Range block;
+        block.minimum = sample.level;
+        block.maximum = sample.level;
+        block.valid = true;
+        blocks.append(block);
+    } else {
+        merge(blocks.last(), sample.level, sample.level);
+    }
+    data.append(sample);
+}
+
+void WaterLevelHistory::expire()
+{
+    quint32 cutoff = now() - MaxAge;
+
+    /* drop whole blocks only, so the summary stays aligned */
+    int blockCount = lowerBound(cutoff) / BlockSize;
+    if (blockCount == 0)
+        return;
+
+    data.remove(0, blockCount * BlockSize);
+    blocks.remove(0, blockCount);
+    stale = true;
+}
+
+/* the file only grows between two compactions, by the expired samples */
+void WaterLevelHistory::compact()
+{
+    if (!stale || writer)
+        return;
+
+    stale = false;
+    appendedSince = 0;
+    writer = new HistoryWriter(file.fileName() + ".new", data, this);
+    connect(writer, SIGNAL(finished()), this, SLOT(compacted()));
+    writer->start(QThread::LowPriority);
+}
+
+/* the samples that came in meanwhile are appended, then the files swapped */
+void WaterLevelHistory::compacted()
+{
+    QFile compactedFile(file.fileName() + ".new");
+    bool ok = writer->hasSucceeded()
+            && compactedFile.open(QIODevice::WriteOnly | QIODevice::Append)
+            && writeSamples(compactedFile, data, data.count() - appendedSince);
+    compactedFile.close();
+    writer->deleteLater();
+    writer = 0;
+
+    if (!ok) {
+        qDebug() << "Water level history can not be compacted" << file.fileName();
+        compactedFile.remove();
+        stale = true;
+        return;
+    }
+
+    file.close();
+    QFile::remove(file.fileName());
+    QFile::rename(compactedFile.fileName(), file.fileName());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        qDebug() << "Water level history can not be written" << file.fileName();
+}
+
+int WaterLevelHistory::lowerBound(quint32 time) const
+{
+    return std::lower_bound(data.constBegin(), data.constEnd(), time, sampleBefore) - data.constBegin();
+}
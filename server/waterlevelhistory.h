@@ -0,0 +1,85 @@
+#ifndef WATERLEVELHISTORY_H
+#define WATERLEVELHISTORY_H
+
+#include <QObject>
+#include <QVector>
+#include <QFile>
+#include <QMap>
+
+class QTimer;
+class HistoryWriter;
+
+/*
+ * Water level samples of one tower for the last month.
+ *
+ * Samples are kept in memory in time order and appended to
+ * history/watertower-N.dat so they survive a reboot. Expired samples only
+ * leave memory right away; once an hour the file is rewritten from a
+ * snapshot on a low priority thread and swapped in. A min/max summary per
+ * block of samples lets a whole month be reduced to a few hundred pixel
+ * columns without visiting every sample.
+ */
+class WaterLevelHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Sample {
+        quint32 time;       /*  seconds since epoch, UTC  */
+        qint16 level;       /*  measured in the unit of "centimetre"  */
+    };
+
+    struct Range {
+        qint16 minimum;
+        qint16 maximum;
+        bool valid;
+    };
+
+    int count() const
+    {
+        return data.count();
+    }
+
+    quint32 firstTime() const;
+    quint32 lastTime() const;
+
+    QVector<Sample> samples(quint32 from, quint32 to) const;
+    void decimate(quint32 from, quint32 to, int buckets, QVector<Range> &ranges) const;
+
+    static WaterLevelHistory *instance(int identity);
+    static const int MaxAge;
+
+signals:
+    void appended();
+
+public slots:
+    void waterLevelChanged(int centimetre);
+
+private slots:
+    void compact();
+    void compacted();
+
+private:
+    Q_DISABLE_COPY(WaterLevelHistory)
+    explicit WaterLevelHistory(int identity, QObject *parent = 0);
+    void load();
+    void append(const Sample &sample);
+    void expire();
+    int lowerBound(quint32 time) const;
+
+private:
+    int identity;
+    QVector<Sample> data;
+    QVector<Range> blocks;
+    QFile file;
+
+    QTimer *compactTimer;
+    HistoryWriter *writer;
+    bool stale;             /*  the file still holds expired samples  */
+    int appendedSince;      /*  samples appended while the writer runs  */
+
+    static const int BlockSize;
+    static QMap<int, WaterLevelHistory*> instanceMap;
+};
+
+#endif // WATERLEVELHISTORY_H
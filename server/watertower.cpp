@@ -1,8 +1,12 @@
 #include <QTimer>
 #include <QDebug>
 
+#include "alarmcontroller.h"
+#include "bootprofiler.h"
 #include "multipointcom.h"
+#include "waterlevelhistory.h"
 #include "settings.h"
+#include "watchdog.h"
 #include "watertower.h"
 
 
@@ -23,11 +27,13 @@ WaterTower::WaterTower(quint8 id, QObject *parent) :
     isAlarm(false)
 {
     com->setAddress(WaterTowerIdentityBase + getAddress());
+    com->setPriority(MultiPointCom::Background);
     connect(com, SIGNAL(responseReceived(char,QByteArray)), this, SLOT(responseReceived(char,QByteArray)));
     connect(com, SIGNAL(deviceConnected()), this, SIGNAL(deviceConnected()));
     connect(com, SIGNAL(deviceDisconnected()), this, SIGNAL(deviceDisconnected()));
     connect(com, SIGNAL(deviceConnected()), this, SLOT(deviceConnect()));
     connect(com, SIGNAL(deviceDisconnected()), this, SLOT(deviceDisconnect()));
+    connect(this, SIGNAL(waterLevelChanged(int)), WaterLevelHistory::instance(identity), SLOT(waterLevelChanged(int)));
 
     getSampleInterval();
     getLevelSensorHeight();
@@ -42,6 +48,7 @@ WaterTower::WaterTower(quint8 id, QObject *parent) :
     enabled = isEnabled();
     if (enabled) {
         timer->start(3 * 1000);
+        Watchdog::instance()->checkIn(QString("scheduler-%1").arg(identity), schedulerDeadline());
     }
 
     alarmEnabled = isAlarmEnabled();
@@ -156,6 +163,21 @@ int WaterTower::getSensorNumber()
     return numberOfSensors;
 }
 
+QPointF WaterTower::getMapPosition()
+{
+    Settings::instance()->beginGroup(QString("WaterTower-%1").arg(identity));
+    QPointF position = Settings::instance()->value("map-position", QPointF(-1, -1)).toPointF();
+    Settings::instance()->endGroup();
+    return position;
+}
+
+void WaterTower::setMapPosition(const QPointF &position)
+{
+    Settings::instance()->beginGroup(QString("WaterTower-%1").arg(identity));
+    Settings::instance()->setValue("map-position", position);
+    Settings::instance()->endGroup();
+}
+
 /* static */
 void WaterTower::setSampleInterval(quint8 second)
 {
@@ -191,6 +213,7 @@ void WaterTower::responseReceived(char protocol, const QByteArray &data)
     Q_UNUSED(protocol); /* always zero */
 
     if (data.size() != 4) {
+        stats.rejected.ref();
         return;
     }
 
@@ -204,6 +227,7 @@ void WaterTower::responseReceived(char protocol, const QByteArray &data)
     usec |= (quint8)data[0];
 
     if (usec > 60000) {
+        stats.rejected.ref();
         return;
     }
 
@@ -229,48 +253,79 @@ void WaterTower::responseReceived(char protocol, const QByteArray &data)
         value = 2;
     else if (msec > (5 - 2))
         value = 1;
-    else
+    else {
+        stats.rejected.ref();
         return;
+    }
 
     value = value -1;
     waterLevel = value * levelSensorHeight;
+    stats.readings.ref();
 
+    /* AlarmController runs the high water level rule from here */
     emit waterLevelChanged(waterLevel);
-
-    if ((value == numberOfSensors) && alarmEnabled) {
-        if (isConnected && !isAlarm) {
-            isAlarm = true;
-            emit highWaterLevelAlarm();
-        }
-    } else if (value < (numberOfSensors - 1)) {
-        isAlarm = false;
-    }
+    BootProfiler::instance()->firstReading(identity);
 }
 
 void WaterTower::deviceConnect()
 {
+    if (!isConnected)
+        stats.connects.ref();
     isConnected = true;
 }
 
 void WaterTower::deviceDisconnect()
 {
+    if (isConnected)
+        stats.disconnects.ref();
     isConnected = false;
 }
 
 void WaterTower::trigger()
 {
     if (enabled) {
-        com->sendRequest(0, QByteArray(1, sampleInterval));
+        stats.polls.ref();
+        if (com->sendRequest(0, QByteArray(1, sampleInterval)))
+            emit requestSent();
+        else
+            stats.busy.ref();
         timer->start(sampleInterval * 1000);
+        Watchdog::instance()->checkIn(QString("scheduler-%1").arg(identity), schedulerDeadline());
+    } else {
+        Watchdog::instance()->release(QString("scheduler-%1").arg(identity));
     }
 }
 
-void WaterTower::pauseAlarm()
+/* a few missed polls, never less than the boot delay plus some slack */
+int WaterTower::schedulerDeadline()
 {
+    return qMax(3 * sampleInterval * 1000, 30 * 1000);
+}
 
+/* quiet for AlarmSnooze seconds, raised again if still full by then */
+void WaterTower::pauseAlarm()
+{
+    AlarmController::instance()->snooze(AlarmController::towerRule(identity), AlarmController::snoozeTime());
 }
 
+/* notified, no reminders until the level drops and rises again */
 void WaterTower::stopAlarm()
 {
+    AlarmController::instance()->acknowledge(AlarmController::towerRule(identity));
+}
 
+/* called by AlarmController, again for every reminder */
+void WaterTower::raiseAlarm()
+{
+    isAlarm = true;
+    stats.alarms.ref();
+    emit highWaterLevelAlarm();
+}
+
+void WaterTower::clearAlarm()
+{
+    if (isAlarm) {
+        isAlarm = false;
+        emit alarmCleared();
+    }
 }
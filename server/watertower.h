@@ -3,6 +3,8 @@
 
 #include <QObject>
 #include <QMap>
+#include <QPointF>
+#include <QAtomicInt>
 
 class QTimer;
 
@@ -12,6 +14,26 @@ class WaterTower : public QObject
 {
     Q_OBJECT
 public:
+    /* lock free, read by MetricsServer */
+    struct Statistics {
+        QAtomicInt polls;
+        QAtomicInt busy;        /*  poll skipped, the previous transfer is still running  */
+        QAtomicInt readings;
+        QAtomicInt rejected;    /*  malformed or out of range replies  */
+        QAtomicInt connects;
+        QAtomicInt disconnects;
+        QAtomicInt alarms;
+    };
+
+    const Statistics &statistics() const
+    {
+        return stats;
+    }
+
+    bool isDeviceConnected() const
+    {
+        return isConnected;
+    }
 
     int getIdentity() const
     {
@@ -35,6 +57,9 @@ public:
     void setSensorNumber(int centimetre);
     int getSensorNumber();
 
+    QPointF getMapPosition();
+    void setMapPosition(const QPointF &position);
+
     int getHeight() const
     {
         return height;
@@ -45,17 +70,30 @@ public:
         return waterLevel;
     }
 
+    /* between two level sensors, measured in the unit of "centimetre" */
+    int getLevelStep() const
+    {
+        return levelSensorHeight;
+    }
+
+    bool isAlarmActive() const
+    {
+        return isAlarm;
+    }
+
     static void setSampleInterval(quint8 second);
     static quint8 getSampleInterval();
     static WaterTower *instance(int identity);
     static const int MaxQuantity;
 
 signals:
+    void requestSent();
     void deviceConnected();
     void deviceDisconnected();
     void waterLevelRangeChanged(int minimum, int maximum);
     void waterLevelChanged(int centimetre);
     void highWaterLevelAlarm();
+    void alarmCleared();
 
 public slots:
     void responseReceived(char protocol, const QByteArray &data);
@@ -64,10 +102,13 @@ public slots:
     void trigger();
     void pauseAlarm();
     void stopAlarm();
+    void raiseAlarm();
+    void clearAlarm();
 
 private:
     Q_DISABLE_COPY(WaterTower)
     explicit WaterTower(quint8 id, QObject *parent = 0);
+    static int schedulerDeadline();
 
 private:
     quint8 identity;
@@ -87,6 +128,8 @@ private:
     bool isConnected;
     bool isAlarm;
 
+    Statistics stats;
+
     static quint8 sampleInterval;
     static QMap<int, WaterTower*> instanceMap;
 };
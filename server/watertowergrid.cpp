@@ -0,0 +1,131 @@
+#include <algorithm>
+
+#include <QScrollBar>
+#include <QResizeEvent>
+#include <QSet>
+
+#include "watertowerwidget.h"
+#include "watertowergrid.h"
+
+WaterTowerGrid::WaterTowerGrid(QWidget *parent) :
+    QAbstractScrollArea(parent),
+    columns(3),
+    rowsPerPage(2)
+{
+    setFrameShape(QFrame::NoFrame);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+}
+
+void WaterTowerGrid::setGrid(int columns, int rowsPerPage)
+{
+    this->columns = qMax(1, columns);
+    this->rowsPerPage = qMax(1, rowsPerPage);
+    updateScrollBars();
+    layoutTiles();
+}
+
+bool WaterTowerGrid::contains(int identity) const
+{
+    QList<int>::const_iterator i = std::lower_bound(towers.constBegin(), towers.constEnd(), identity);
+    return i != towers.constEnd() && *i == identity;
+}
+
+void WaterTowerGrid::insertTower(int identity)
+{
+    QList<int>::iterator i = std::lower_bound(towers.begin(), towers.end(), identity);
+    if (i != towers.end() && *i == identity)
+        return;
+
+    towers.insert(i, identity);
+    updateScrollBars();
+    layoutTiles();
+}
+
+void WaterTowerGrid::removeTower(int identity)
+{
+    QList<int>::iterator i = std::lower_bound(towers.begin(), towers.end(), identity);
+    if (i == towers.end() || *i != identity)
+        return;
+
+    towers.erase(i);
+    updateScrollBars();
+    layoutTiles();
+}
+
+void WaterTowerGrid::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+    layoutTiles();
+}
+
+void WaterTowerGrid::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+    layoutTiles();
+}
+
+QSize WaterTowerGrid::tileSize() const
+{
+    QSize size = viewport()->size();
+    return QSize(size.width() / columns, size.height() / rowsPerPage);
+}
+
+int WaterTowerGrid::rowCount() const
+{
+    return (towers.count() + columns - 1) / columns;
+}
+
+void WaterTowerGrid::updateScrollBars()
+{
+    int rowHeight = tileSize().height();
+    QScrollBar *bar = verticalScrollBar();
+    bar->setSingleStep(rowHeight);
+    bar->setPageStep(rowHeight * rowsPerPage);
+    bar->setRange(0, qMax(0, (rowCount() - rowsPerPage) * rowHeight));
+}
+
+void WaterTowerGrid::layoutTiles()
+{
+    QSize tile = tileSize();
+    if (tile.isEmpty())
+        return;
+
+    int offset = verticalScrollBar()->value();
+    int firstRow = offset / tile.height();
+    int lastRow = (offset + viewport()->height() - 1) / tile.height();
+    int first = firstRow * columns;
+    int last = qMin(towers.count(), (lastRow + 1) * columns);
+
+    QSet<int> onScreen;
+    for (int index = first; index < last; index++) {
+        int identity = towers.at(index);
+        onScreen.insert(identity);
+
+        QWidget *widget = visibleTiles.value(identity);
+        if (!widget) {
+            widget = WaterTowerWidget::instance(identity);
+            if (widget->parentWidget() != viewport())
+                widget->setParent(viewport());
+            visibleTiles.insert(identity, widget);
+        }
+
+        QRect geometry(QPoint((index % columns) * tile.width(), (index / columns) * tile.height() - offset), tile);
+        if (widget->geometry() != geometry)
+            widget->setGeometry(geometry);
+        if (widget->isHidden())
+            widget->show();
+    }
+
+    QMap<int, QWidget *>::iterator i = visibleTiles.begin();
+    while (i != visibleTiles.end()) {
+        if (!onScreen.contains(i.key())) {
+            i.value()->hide();
+            i = visibleTiles.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef WATERTOWERGRID_H
+#define WATERTOWERGRID_H
+
+#include <QAbstractScrollArea>
+#include <QList>
+#include <QMap>
+
+/*
+ * Scrollable, paged grid of water tower tiles.
+ *
+ * The tiles are the WaterTowerWidget instances, which exist anyway for the
+ * options page. Only those intersecting the viewport are positioned and
+ * shown; everything else stays hidden and therefore never paints. Enabling
+ * or disabling a tower only touches the tiles that actually move.
+ */
+class WaterTowerGrid : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit WaterTowerGrid(QWidget *parent = 0);
+
+    void setGrid(int columns, int rowsPerPage);
+
+    int count() const
+    {
+        return towers.count();
+    }
+
+    bool contains(int identity) const;
+
+public slots:
+    void insertTower(int identity);
+    void removeTower(int identity);
+
+protected:
+    void resizeEvent(QResizeEvent *event);
+    void scrollContentsBy(int dx, int dy);
+
+private:
+    QSize tileSize() const;
+    int rowCount() const;
+    void updateScrollBars();
+    void layoutTiles();
+
+private:
+    QList<int> towers;              /*  identities of the enabled towers, sorted  */
+    QMap<int, QWidget *> visibleTiles;
+
+    int columns;
+    int rowsPerPage;
+};
+
+#endif // WATERTOWERGRID_H
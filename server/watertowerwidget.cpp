@@ -1,42 +1,26 @@
 #include <QMessageBox>
+#include <QMouseEvent>
 #include <QDebug>
 
+#include "alarmcontroller.h"
 #include "watertower.h"
 #include "watertowerwidget.h"
 #include "notifypanel.h"
+#include "historychart.h"
+#include "hal.h"
 #include "ui_watertowerwidget.h"
 
 QSpinBox *WaterTowerWidget::sampleIntervalWidget = 0;
 QMap<int, WaterTowerWidget*> WaterTowerWidget::instanceMap;
 
-const char *volumeStyle =
-    "color: #%1;";
-
-const char *connectStyle =
-    "QProgressBar {"
-        "border: 2px solid grey;"
-        "border-radius: 5px;"
-        "text-align: center;"
-    "}"
-    "QProgressBar::chunk {"
-        "background-color: qlineargradient(x1: 0, y1: 0, x2: 0, y2: 1,"
-                           "stop: 0 #%1, stop: 1.0 #0000FF);"
-    "}";
-
-const char *disconnectStyle =
-    "QProgressBar {"
-        "border: 2px solid grey;"
-        "border-radius: 5px;"
-        "text-align: center;"
-    "}"
-    "QProgressBar::chunk {"
-        "background-color: lightGray;"
-    "}";
-
 WaterTowerWidget::WaterTowerWidget(int id, QWidget *parent) :
     QGroupBox(parent),
     ui(new Ui::WaterTowerWidget),
-    uuid(NotifyPanel::instance()->uuid())
+    uuid(AlarmController::ruleUuid(AlarmController::towerRule(id))),
+    displayOff(false),
+    pendingUpdate(false),
+    pendingConnected(false),
+    pendingLevel(0)
 {
     ui->setupUi(this);
 
@@ -46,13 +30,13 @@ WaterTowerWidget::WaterTowerWidget(int id, QWidget *parent) :
     connect(waterTower, SIGNAL(deviceConnected()), this, SLOT(deviceConnect()));
     connect(waterTower, SIGNAL(deviceDisconnected()), this, SLOT(deviceDisconnect()));
     connect(waterTower, SIGNAL(highWaterLevelAlarm()), this, SLOT(highWaterLevelAlarm()));
+    connect(Hal::instance(), SIGNAL(powerChanged(bool)), this, SLOT(powerChanged(bool)));
 
     waterTower->getWaterLevel();
     ui->avatarWidget->setAvatar(QPixmap(QString(qApp->applicationDirPath() + "/images/watertower-%1.png").arg(id)));
-    ui->progressBar->setRange(0, waterTower->getHeight());
-    ui->progressBar->setFormat("%v");
+    ui->levelGauge->setRange(0, waterTower->getHeight());
     deviceDisconnect();
-    connect(waterTower, SIGNAL(waterLevelRangeChanged(int,int)), ui->progressBar, SLOT(setRange(int,int)));
+    connect(waterTower, SIGNAL(waterLevelRangeChanged(int,int)), ui->levelGauge, SLOT(setRange(int,int)));
 
     enableWidget = new QCheckBox();
     enableWidget->setChecked(waterTower->isEnabled());
@@ -84,6 +68,11 @@ WaterTowerWidget::WaterTowerWidget(int id, QWidget *parent) :
     connect(sampleIntervalWidget, SIGNAL(valueChanged(int)), this, SLOT(sampleIntervalChanged(int)));
     connect(enableWidget, SIGNAL(clicked(bool)), this, SLOT(readyForUse(bool)));
     connect(enableAlarmWidget, SIGNAL(clicked(bool)), this, SLOT(enableAlarm(bool)));
+
+    /* a paused rule is kept across reboots, it must not go unnoticed */
+    connect(AlarmController::instance(), SIGNAL(pausedChanged(QString,bool)), this, SLOT(alarmPausedChanged()));
+    connect(ui->pausedButton, SIGNAL(clicked()), this, SLOT(resumeAlarm()));
+    alarmPausedChanged();
 }
 
 QString WaterTowerWidget::readableName(int id)
@@ -139,7 +128,7 @@ void WaterTowerWidget::sampleIntervalChanged(int value)
 void WaterTowerWidget::readyForUse(bool checked)
 {
     waterTower->setEnable(checked);
-    emit layoutChanged();
+    emit layoutChanged(waterTower->getIdentity(), checked);
 }
 
 void WaterTowerWidget::enableAlarm(bool checked)
@@ -169,17 +158,14 @@ void WaterTowerWidget::levelSensorNumberChanged(int value)
 
 void WaterTowerWidget::waterLevelChanged(int centimetre)
 {
-    int maximum = ui->progressBar->maximum();
-    int color = ((0xff * centimetre / maximum) << 16) + (0xff * (maximum - centimetre) / maximum);
-    ui->volumeLabel->setStyleSheet(QString(volumeStyle).arg(color, 6, 16, QLatin1Char('0')));
-    ui->progressBar->setStyleSheet(QString(connectStyle).arg(color, 6, 16, QLatin1Char('0')));
-    ui->progressBar->setValue(centimetre);
-    // ui->progressBar->setTextVisible(true);
+    if (displayOff) {
+        pendingUpdate = true;
+        pendingConnected = true;
+        pendingLevel = centimetre;
+        return;
+    }
 
-    double radius = waterTower->getRadius() / 100.0;
-    double volume = 3.1415926 * radius * radius * (centimetre / 100.0);
-    ui->volumeLabel->setText(QString::number(volume, 'f', 1));
-    ui->volumeLabel->setVisible(true);
+    showWaterLevel(centimetre);
 }
 
 void WaterTowerWidget::deviceConnect()
@@ -189,10 +175,13 @@ void WaterTowerWidget::deviceConnect()
 
 void WaterTowerWidget::deviceDisconnect()
 {
-    ui->progressBar->setStyleSheet(disconnectStyle);
-    ui->progressBar->setValue(waterTower->getHeight() / 2);
-    ui->progressBar->setTextVisible(false);
-    ui->volumeLabel->setVisible(false);
+    if (displayOff) {
+        pendingUpdate = true;
+        pendingConnected = false;
+        return;
+    }
+
+    showDisconnected();
 }
 
 void WaterTowerWidget::highWaterLevelAlarm()
@@ -200,5 +189,72 @@ void WaterTowerWidget::highWaterLevelAlarm()
     NotifyPanel::instance()->addNotify(uuid, NotifyPanel::Middle,
             tr("%1: High water level!").arg(readableName(waterTower->getIdentity())),
             QString(qApp->applicationDirPath() + "/images/watertower-%1.png").arg(waterTower->getIdentity()));
-    waterTower->stopAlarm();
+}
+
+void WaterTowerWidget::powerChanged(bool on)
+{
+    displayOff = !on;
+    if (on && pendingUpdate) {
+        pendingUpdate = false;
+        if (pendingConnected)
+            showWaterLevel(pendingLevel);
+        else
+            showDisconnected();
+    }
+}
+
+void WaterTowerWidget::alarmPausedChanged()
+{
+    ui->pausedButton->setVisible(!AlarmController::instance()->pausedRules(waterTower->getIdentity()).isEmpty());
+}
+
+void WaterTowerWidget::resumeAlarm()
+{
+    QStringList names = AlarmController::instance()->pausedRules(waterTower->getIdentity());
+    if (names.isEmpty())
+        return;
+
+    if (QMessageBox::question(window(), title(), tr("Resume the paused alarm rule(s) %1?").arg(names.join(", ")),
+                              QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+        return;
+    foreach (const QString &name, names)
+        AlarmController::instance()->resume(name);
+}
+
+void WaterTowerWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    QGroupBox::mouseReleaseEvent(event);
+    if (event->button() == Qt::LeftButton && rect().contains(event->pos())) {
+        HistoryDialog dialog(waterTower, title(), window());
+#ifdef __arm__
+        dialog.showFullScreen();
+#endif
+        dialog.exec();
+    }
+}
+
+void WaterTowerWidget::showWaterLevel(int centimetre)
+{
+    ui->levelGauge->setConnected(true);
+    ui->levelGauge->setValue(centimetre);
+
+    QColor color = ui->levelGauge->levelColor();
+    QPalette palette = ui->volumeLabel->palette();
+    if (palette.color(QPalette::WindowText) != color) {
+        palette.setColor(QPalette::WindowText, color);
+        ui->volumeLabel->setPalette(palette);
+    }
+
+    double radius = waterTower->getRadius() / 100.0;
+    double volume = 3.1415926 * radius * radius * (centimetre / 100.0);
+    QString text = QString::number(volume, 'f', 1);
+    if (ui->volumeLabel->text() != text)
+        ui->volumeLabel->setText(text);
+    ui->volumeLabel->setVisible(true);
+}
+
+void WaterTowerWidget::showDisconnected()
+{
+    ui->levelGauge->setConnected(false);
+    ui->volumeLabel->setVisible(false);
 }
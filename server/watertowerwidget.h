@@ -52,7 +52,7 @@ public:
     static WaterTowerWidget *instance(int identity);
 
 signals:
-    void layoutChanged();
+    void layoutChanged(int identity, bool enabled);
 
 public slots:
     void sampleIntervalChanged(int value);
@@ -66,16 +66,31 @@ public slots:
     void deviceConnect();
     void deviceDisconnect();
     void highWaterLevelAlarm();
+    void powerChanged(bool on);
+
+private slots:
+    void alarmPausedChanged();
+    void resumeAlarm();
+
+protected:
+    void mouseReleaseEvent(QMouseEvent *event);
 
 private:
     Q_DISABLE_COPY(WaterTowerWidget)
     explicit WaterTowerWidget(int id, QWidget *parent = 0);
+    void showWaterLevel(int centimetre);
+    void showDisconnected();
 
 
 private:
     Ui::WaterTowerWidget *ui;
     WaterTower *waterTower;
-    QString uuid;
+    QString uuid;           /*  of the tower's alarm rule, confirming it acknowledges the rule  */
+
+    bool displayOff;
+    bool pendingUpdate;
+    bool pendingConnected;
+    int pendingLevel;
 
     QCheckBox *enableWidget;
     QCheckBox *enableAlarmWidget;